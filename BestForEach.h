@@ -0,0 +1,412 @@
+/*
+ * By Paul Dreik 2019,2020
+ * https://www.pauldreik.se/
+ * License: Boost 1.0
+ * SPDX-License-Identifier: BSL-1.0
+ */
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <map>
+#include <mutex>
+#include <random>
+#include <string>
+
+#include <unistd.h>
+
+#include "CryptoForEach.h"
+#include "Feistel128.h"
+#include "Fnv1aCiphers.h"
+#include "murmur32.h"
+#include "simdfeistel.h"
+
+/**
+ * the engines best_for_each picks from. They all visit [0,M) exactly once,
+ * but in different orders for the same seed.
+ */
+enum class ForEachEngine
+{
+  SimdMurmur,
+  AesFeistel,
+  Fn1vaFeistel,
+  SimdFeistel
+};
+constexpr int ForEachEngines = 4;
+
+/**
+ * how well the order is shuffled, in increasing order. Fast is the two
+ * round fnv1a feistel, which fails the avalanche test of quickcheck.
+ * Mixed is the murmur finalizer, which mixes well but is keyed only by an
+ * xor of the input. Cipher is Aes128Feistel<4> at all widths, four aes
+ * rounds with a key each, which passes quickcheck (as aes128) and walks
+ * cycles with about one fixed point like a random permutation does, see
+ * cyclewalk_test.cpp. Aes32 is not used: with the same key in every round
+ * it is an involution.
+ */
+enum class QualityTier
+{
+  Fast,
+  Mixed,
+  Cipher
+};
+
+inline const char*
+engine_name(ForEachEngine engine)
+{
+  constexpr const char* names[ForEachEngines] = {
+    "simdmurmur", "aes_feistel", "fn1va_feistel", "simd_feistel"
+  };
+  return names[static_cast<int>(engine)];
+}
+
+inline QualityTier
+engine_quality(ForEachEngine engine)
+{
+  switch (engine) {
+    case ForEachEngine::SimdMurmur:
+      return QualityTier::Mixed;
+    case ForEachEngine::AesFeistel:
+      return QualityTier::Cipher;
+    case ForEachEngine::Fn1vaFeistel:
+    case ForEachEngine::SimdFeistel:
+      return QualityTier::Fast;
+  }
+  std::abort();
+}
+
+/**
+ * visits [0,M) with the given engine, seeded from seed. cb gets the values
+ * as Integer.
+ */
+template<typename Integer, typename Callback>
+void
+engine_for_each(ForEachEngine engine,
+                Integer M,
+                std::uint64_t seed,
+                Callback&& cb)
+{
+  std::mt19937_64 rng(seed);
+  auto deliver = [&](auto value) { cb(static_cast<Integer>(value)); };
+  const bool wide = even_bits_needed(M) > 32;
+  switch (engine) {
+    case ForEachEngine::SimdMurmur:
+      simdmurmur_for_each(M, rng, deliver);
+      return;
+    case ForEachEngine::AesFeistel:
+      crypto_for_each<Aes128Feistel<4>>(uint128{ M }, rng, deliver);
+      return;
+    case ForEachEngine::Fn1vaFeistel:
+      if (wide) {
+        crypto_for_each<Dynamic64>(M, rng, deliver);
+      } else {
+        crypto_for_each<Dynamic32>(M, rng, deliver);
+      }
+      return;
+    case ForEachEngine::SimdFeistel:
+      simdfeistel_for_each(M, rng, deliver);
+      return;
+  }
+  std::abort();
+}
+
+namespace BestForEachInternals {
+
+/// ranges are benchmarked in buckets of eight bits
+inline int
+width_bucket(std::uint64_t M)
+{
+  return std::max(8, (bits_needed(M) + 7) / 8 * 8);
+}
+
+inline std::string
+host_name()
+{
+  char buf[256] = {};
+  if (::gethostname(buf, sizeof(buf) - 1) != 0 || buf[0] == '\0') {
+    return "unknown";
+  }
+  return buf;
+}
+
+/**
+ * where the profile is kept: $RANDOM_FOREACH_PROFILE if set (empty means
+ * nowhere), otherwise in the cache directory.
+ */
+inline std::string
+profile_path()
+{
+  if (const char* path = std::getenv("RANDOM_FOREACH_PROFILE")) {
+    return path;
+  }
+  if (const char* cache = std::getenv("XDG_CACHE_HOME")) {
+    return std::string(cache) + "/random_foreach.profile";
+  }
+  if (const char* home = std::getenv("HOME")) {
+    return std::string(home) + "/.cache/random_foreach.profile";
+  }
+  return {};
+}
+
+/**
+ * keeps the delivered values per second of each engine, per host and width
+ * bucket. The file has one measurement per line,
+ *   host bucket engine rate
+ * and is appended to, so a later line for the same key wins.
+ */
+class Profile
+{
+public:
+  explicit Profile(std::string path)
+    : m_path(std::move(path))
+  {
+    if (m_path.empty()) {
+      return;
+    }
+    std::FILE* file = std::fopen(m_path.c_str(), "r");
+    if (!file) {
+      return;
+    }
+    char host[256];
+    int bucket;
+    char engine[64];
+    double rate;
+    while (
+      std::fscanf(file, "%255s %d %63s %lf", host, &bucket, engine, &rate) ==
+      4) {
+      m_rates[key(host, bucket, engine)] = rate;
+    }
+    std::fclose(file);
+  }
+
+  /// the rate, or 0 if not measured
+  double rate(const std::string& host, int bucket, ForEachEngine engine) const
+  {
+    auto it = m_rates.find(key(host, bucket, engine_name(engine)));
+    return it == m_rates.end() ? 0.0 : it->second;
+  }
+
+  void store(const std::string& host,
+             int bucket,
+             ForEachEngine engine,
+             double rate)
+  {
+    m_rates[key(host, bucket, engine_name(engine))] = rate;
+    if (m_path.empty()) {
+      return;
+    }
+    // failing to save is not an error, it is measured again next time
+    if (std::FILE* file = std::fopen(m_path.c_str(), "a")) {
+      std::fprintf(file,
+                   "%s %d %s %.6g\n",
+                   host.c_str(),
+                   bucket,
+                   engine_name(engine),
+                   rate);
+      std::fclose(file);
+    }
+  }
+
+private:
+  static std::string key(const std::string& host,
+                         int bucket,
+                         const std::string& engine)
+  {
+    return host + ' ' + std::to_string(bucket) + ' ' + engine;
+  }
+
+  std::string m_path;
+  std::map<std::string, double> m_rates;
+};
+
+/**
+ * runs body(batch) repeatedly, which returns the number of values it
+ * delivered. returns the best values per second of a few short runs.
+ */
+template<typename Body>
+double
+measure(Body&& body)
+{
+  using Clock = std::chrono::steady_clock;
+  const auto minimum = std::chrono::milliseconds(3);
+  double best = 0;
+  for (int run = 0; run < 3; ++run) {
+    std::uint64_t delivered = 0;
+    const auto start = Clock::now();
+    auto elapsed = Clock::duration::zero();
+    do {
+      delivered += body();
+      elapsed = Clock::now() - start;
+    } while (elapsed < minimum);
+    const double seconds = std::chrono::duration<double>(elapsed).count();
+    best = std::max(best, static_cast<double>(delivered) / seconds);
+  }
+  return best;
+}
+
+// keeps the benchmarked values alive
+inline volatile std::uint64_t sink;
+
+template<typename Crypto>
+double
+bench_scalar(std::uint64_t M)
+{
+  const int bits = even_bits_needed(M);
+  Crypto cipher(bits);
+  std::mt19937_64 rng(0);
+  cipher.seed(rng);
+  // the counters wrap around within the cipher domain
+  const std::uint64_t wrap = (std::uint64_t{ 1 } << (bits - 1) << 1) - 1;
+  std::uint64_t counter = 0;
+  return measure([&]() {
+    std::uint64_t delivered = 0;
+    std::uint64_t acc = 0;
+    for (int i = 0; i < 1024; ++i) {
+      const auto encrypted = cipher.encrypt(counter++ & wrap);
+      if (encrypted < M) {
+        acc ^= static_cast<std::uint64_t>(encrypted);
+        ++delivered;
+      }
+    }
+    sink = acc;
+    return delivered;
+  });
+}
+
+template<typename SimdCrypto>
+double
+bench_simd(std::uint64_t M, int bits)
+{
+  using Vec = typename SimdCrypto::Vec;
+  SimdCrypto cipher(bits);
+  std::mt19937_64 rng(0);
+  cipher.seed(rng);
+  using Lane = typename Vec::Int;
+  const Vec wrap{ static_cast<Lane>((std::uint64_t{ 1 } << (bits - 1) << 1) -
+                                    1) };
+  Vec II = Vec::iota();
+  const Vec lanes(Vec::size());
+  return measure([&]() {
+    std::uint64_t delivered = 0;
+    std::uint64_t acc = 0;
+    for (int i = 0; i < 1024 / Vec::size(); ++i, II += lanes) {
+      for (auto encrypted : cipher.encrypt(II & wrap).toArray()) {
+        if (encrypted < M) {
+          acc ^= encrypted;
+          ++delivered;
+        }
+      }
+    }
+    sink = acc;
+    return delivered;
+  });
+}
+
+/**
+ * the delivered values per second of engine, on a range in the bucket. The
+ * engines are run the same way as engine_for_each does, without the
+ * callback.
+ */
+inline double
+bench(ForEachEngine engine, int bucket)
+{
+  // the largest even bit width in the bucket, three quarters full
+  const std::uint64_t M = (std::uint64_t{ 3 } << (bucket - 2));
+  const int even = even_bits_needed(M);
+  switch (engine) {
+    case ForEachEngine::SimdMurmur: {
+      const int bits = bits_needed(M);
+      if (bits <= 16) {
+        return bench_simd<SimdMurmur16>(M, bits);
+      }
+      if (bits <= 32) {
+        return bench_simd<SimdMurmur32>(M, bits);
+      }
+      return bench_simd<SimdMurmur64>(M, bits);
+    }
+    case ForEachEngine::AesFeistel:
+      return bench_scalar<Aes128Feistel<4>>(M);
+    case ForEachEngine::Fn1vaFeistel:
+      return even > 32 ? bench_scalar<Dynamic64>(M)
+                       : bench_scalar<Dynamic32>(M);
+    case ForEachEngine::SimdFeistel:
+      if (even <= 16) {
+        return bench_simd<ParallelFeistel16>(M, even);
+      }
+      if (even <= 32) {
+        return bench_simd<ParallelFeistel>(M, even);
+      }
+      return bench_simd<ParallelFeistel64>(M, even);
+  }
+  std::abort();
+}
+}
+
+/**
+ * the fastest engine on this host for ranges like [0,M), among those of
+ * at least the given quality. Engines are benchmarked the first time a
+ * width bucket is asked for, and the results are kept in a profile file
+ * (see BestForEachInternals::profile_path) so later runs, also in other
+ * processes, skip the benchmark.
+ *
+ * $RANDOM_FOREACH_ENGINE set to an engine name overrides the choice.
+ */
+inline ForEachEngine
+best_engine(std::uint64_t M, QualityTier minimum = QualityTier::Fast)
+{
+  using namespace BestForEachInternals;
+  if (const char* forced = std::getenv("RANDOM_FOREACH_ENGINE")) {
+    for (int e = 0; e < ForEachEngines; ++e) {
+      if (std::string(forced) == engine_name(static_cast<ForEachEngine>(e))) {
+        return static_cast<ForEachEngine>(e);
+      }
+    }
+    std::puts("RANDOM_FOREACH_ENGINE names an unknown engine");
+    std::abort();
+  }
+
+  static std::mutex mutex;
+  static Profile profile(profile_path());
+  static const std::string host = host_name();
+  const std::lock_guard<std::mutex> lock(mutex);
+  const int bucket = width_bucket(M);
+  ForEachEngine best = ForEachEngine::AesFeistel;
+  double best_rate = -1;
+  for (int e = 0; e < ForEachEngines; ++e) {
+    const auto engine = static_cast<ForEachEngine>(e);
+    if (engine_quality(engine) < minimum) {
+      continue;
+    }
+    double rate = profile.rate(host, bucket, engine);
+    if (rate <= 0) {
+      rate = bench(engine, bucket);
+      profile.store(host, bucket, engine, rate);
+    }
+    if (rate > best_rate) {
+      best_rate = rate;
+      best = engine;
+    }
+  }
+  return best;
+}
+
+/**
+ * visits [0,M) in random order with the fastest engine of at least the
+ * given quality on this host, see best_engine. The order depends on which
+ * engine is picked, use engine_for_each to get the same order everywhere.
+ */
+template<typename Integer, typename Callback>
+void
+best_for_each(Integer M,
+              std::uint64_t seed,
+              Callback&& cb,
+              QualityTier minimum = QualityTier::Fast)
+{
+  if (M == 0) {
+    return;
+  }
+  engine_for_each(best_engine(M, minimum), M, seed, cb);
+}
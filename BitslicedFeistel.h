@@ -0,0 +1,236 @@
+/*
+ * By Paul Dreik 2019,2020
+ * https://www.pauldreik.se/
+ * License: Boost 1.0
+ * SPDX-License-Identifier: BSL-1.0
+ */
+#pragma once
+
+#include <immintrin.h>
+#include <array>
+#include <cassert>
+#include <cstdint>
+
+/**
+ * @brief The BitslicedFeistel class
+ * A feistel cipher for domains up to 2^32, encrypting 256 values at a time
+ * in bitsliced form: vector j holds bit j of all 256 values, one per bit
+ * of the vector. The round function is that of Simon,
+ *
+ *   f(x) = (rotl(x,1) & rotl(x,h/2)) ^ rotl(x,2) ^ key
+ *
+ * on halves of h bits (h=16 gives the rotations 1, 8 and 2 of Simon32).
+ * Rotations are free in bitsliced form, since they only change which
+ * vector is read, so a round is about four logic instructions per bit for
+ * all 256 values.
+ *
+ * encrypt256 is meant for consecutive counters. Their bitsliced form is
+ * constant except for the base, so only the output needs transposing.
+ * encrypt does the same for a single value, as a reference.
+ *
+ * 12 rounds is where the avalanche of 32 bit blocks looks flat, 8 rounds
+ * is clearly biased. A round costs a fraction of a round of
+ * ParallelFeistel per value, but the transposition costs about as much
+ * as the two rounds of ParallelFeistel, so the encryption alone is
+ * somewhat slower while mixing much better. Handing out values from
+ * blocks of 256 is cheaper though, in shootout with N=10^8:
+ * simd_feistel      6.2 s
+ * bitsliced_feistel 4.7 s
+ */
+class BitslicedFeistel
+{
+public:
+  static constexpr int ROUNDS = 12;
+  static constexpr int Lanes = 256;
+
+  explicit BitslicedFeistel(int Nbits)
+    : m_half(Nbits / 2)
+    , m_halfmask((std::uint32_t{ 1 } << m_half) - 1)
+  {
+    assert(Nbits % 2 == 0 && Nbits >= 2 && Nbits <= 32);
+    m_key.fill(0);
+    setKeySlices();
+  }
+
+  template<typename URBG>
+  void seed(URBG&& urbg)
+  {
+    for (auto& e : m_key) {
+      e = static_cast<std::uint32_t>(urbg()) & m_halfmask;
+    }
+    setKeySlices();
+  }
+
+  std::uint32_t encrypt(std::uint32_t x) const
+  {
+    std::uint32_t right = x & m_halfmask;
+    std::uint32_t left = x >> m_half;
+    for (int r = 0; r < ROUNDS; ++r) {
+      const std::uint32_t f =
+        (rotl(right, 1) & rotl(right, m_half / 2)) ^ rotl(right, 2) ^ m_key[r];
+      const std::uint32_t tmp = left ^ f;
+      left = right;
+      right = tmp;
+    }
+    return (left << m_half) | right;
+  }
+
+  /**
+   * writes encrypt(base + i) to out[i], for i in [0,256). base must be a
+   * multiple of 256. Counters beyond the domain wrap around.
+   */
+  void encrypt256(std::uint32_t base, std::uint32_t* out) const
+  {
+    assert(base % Lanes == 0);
+    switch (m_half) {
+      case 1:
+        return encrypt256<1>(base, out);
+      case 2:
+        return encrypt256<2>(base, out);
+      case 3:
+        return encrypt256<3>(base, out);
+      case 4:
+        return encrypt256<4>(base, out);
+      case 5:
+        return encrypt256<5>(base, out);
+      case 6:
+        return encrypt256<6>(base, out);
+      case 7:
+        return encrypt256<7>(base, out);
+      case 8:
+        return encrypt256<8>(base, out);
+      case 9:
+        return encrypt256<9>(base, out);
+      case 10:
+        return encrypt256<10>(base, out);
+      case 11:
+        return encrypt256<11>(base, out);
+      case 12:
+        return encrypt256<12>(base, out);
+      case 13:
+        return encrypt256<13>(base, out);
+      case 14:
+        return encrypt256<14>(base, out);
+      case 15:
+        return encrypt256<15>(base, out);
+      default:
+        return encrypt256<16>(base, out);
+    }
+  }
+
+private:
+  // bit j of a half rotated left by k is bit j-k
+  template<int H>
+  static constexpr int rot(int j, int k)
+  {
+    return (j + H - k % H) % H;
+  }
+
+  /// left ^= f(right), for the key of round r
+  template<int H>
+  void round(__m256i* left, const __m256i* right, int r) const
+  {
+    // unrolled, so the rotations pick registers instead of indexing
+#pragma GCC unroll 16
+    for (int j = 0; j < H; ++j) {
+      const __m256i f = _mm256_xor_si256(
+        _mm256_and_si256(right[rot<H>(j, 1)], right[rot<H>(j, H / 2)]),
+        right[rot<H>(j, 2)]);
+      left[j] = _mm256_xor_si256(left[j],
+                                 _mm256_xor_si256(f, m_keyslices[r][j]));
+    }
+  }
+
+  template<int H>
+  void encrypt256(std::uint32_t base, std::uint32_t* out) const
+  {
+    // bit j of the counter, for each of the 256 values. value 8*i+g is in
+    // bit i of 32 bit lane g, so the transpose below leaves eight
+    // consecutive values in each vector.
+    __m256i slices[32];
+    slices[0] = _mm256_setr_epi32(0, -1, 0, -1, 0, -1, 0, -1);
+    slices[1] = _mm256_setr_epi32(0, 0, -1, -1, 0, 0, -1, -1);
+    slices[2] = _mm256_setr_epi32(0, 0, 0, 0, -1, -1, -1, -1);
+    slices[3] = _mm256_set1_epi32(0xAAAAAAAA);
+    slices[4] = _mm256_set1_epi32(0xCCCCCCCC);
+    slices[5] = _mm256_set1_epi32(0xF0F0F0F0);
+    slices[6] = _mm256_set1_epi32(0xFF00FF00);
+    slices[7] = _mm256_set1_epi32(0xFFFF0000);
+    for (int j = 8; j < 32; ++j) {
+      slices[j] = _mm256_set1_epi32(-static_cast<int>((base >> j) & 1U));
+    }
+
+    // an even number of rounds ends with the halves where they started
+    static_assert(ROUNDS % 2 == 0, "");
+    __m256i* right = slices;
+    __m256i* left = slices + H;
+    for (int r = 0; r < ROUNDS; r += 2) {
+      round<H>(left, right, r);
+      round<H>(right, left, r + 1);
+    }
+    for (int j = 2 * H; j < 32; ++j) {
+      slices[j] = _mm256_setzero_si256();
+    }
+
+    transpose(slices);
+    // slices[i] now has value 8*i+g in lane g
+    for (int i = 0; i < 32; ++i) {
+      _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + 8 * i), slices[i]);
+    }
+  }
+
+  std::uint32_t rotl(std::uint32_t x, int k) const
+  {
+    k %= m_half;
+    if (k == 0) {
+      return x;
+    }
+    return ((x << k) | (x >> (m_half - k))) & m_halfmask;
+  }
+
+  void setKeySlices()
+  {
+    for (int r = 0; r < ROUNDS; ++r) {
+      for (int j = 0; j < 16; ++j) {
+        m_keyslices[r][j] =
+          _mm256_set1_epi32(-static_cast<int>((m_key[r] >> j) & 1U));
+      }
+    }
+  }
+
+  /**
+   * transposes the 32x32 bit matrix in each 32 bit lane, so bit i of row j
+   * moves to bit j of row i. Blocks are swapped in halving sizes, see
+   * transpose32 in Hacker's Delight.
+   */
+  static void transpose(__m256i* rows)
+  {
+    transposeStep<16>(rows, 0x0000FFFF);
+    transposeStep<8>(rows, 0x00FF00FF);
+    transposeStep<4>(rows, 0x0F0F0F0F);
+    transposeStep<2>(rows, 0x33333333);
+    transposeStep<1>(rows, 0x55555555);
+  }
+
+  template<int S>
+  static void transposeStep(__m256i* rows, std::uint32_t mask)
+  {
+    const __m256i m = _mm256_set1_epi32(static_cast<int>(mask));
+#pragma GCC unroll 32
+    for (int j = 0; j < 32; ++j) {
+      if (j & S) {
+        continue;
+      }
+      const __m256i t = _mm256_and_si256(
+        _mm256_xor_si256(_mm256_srli_epi32(rows[j], S), rows[j + S]), m);
+      rows[j + S] = _mm256_xor_si256(rows[j + S], t);
+      rows[j] = _mm256_xor_si256(rows[j], _mm256_slli_epi32(t, S));
+    }
+  }
+
+  int m_half;
+  std::uint32_t m_halfmask;
+  std::array<std::uint32_t, ROUNDS> m_key;
+  // all ones where the key bit is set
+  __m256i m_keyslices[ROUNDS][16];
+};
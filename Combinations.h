@@ -0,0 +1,201 @@
+#pragma once
+/*
+ * By Paul Dreik 2019,2020
+ * https://www.pauldreik.se/
+ * License: Boost 1.0
+ * SPDX-License-Identifier: BSL-1.0
+ */
+#include <algorithm>
+#include <array>
+#include <cassert>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <limits>
+#include <vector>
+
+#include "CryptoForEach.h"
+#include "MixedRadix.h"
+
+/**
+ * @brief The CombinationSpace class
+ * The K-subsets of [0,N), each numbered by a rank in [0,C(N,K)) through the
+ * combinatorial number system: the subset c_K > ... > c_1 has rank
+ * C(c_K,K) + ... + C(c_1,1).
+ *
+ * Visiting the ranks in random order visits each subset once, without
+ * spending encryptions on the tuples that are not subsets (like the i>=j
+ * half of the pairs).
+ *
+ * Pairs (K=2) are decoded in closed form. For larger K, a table of
+ * binomial coefficients is used (K*N entries), and each component is
+ * estimated from an approximate inverse of the binomial coefficient and
+ * then corrected with a few table lookups.
+ */
+template<std::size_t K>
+class CombinationSpace
+{
+public:
+  static_assert(K > 0, "K must be positive");
+  using Subset = std::array<std::uint64_t, K>;
+
+  explicit CombinationSpace(std::uint64_t N)
+    : m_N(N)
+  {
+    if constexpr (K == 2) {
+      m_size = checked_binom2(N);
+    } else {
+      // m_binom[(i-1)*N+c] is C(c,i)
+      m_binom.resize(K * N);
+      for (std::size_t i = 1; i <= K; ++i) {
+        for (std::uint64_t c = 0; c < N; ++c) {
+          std::uint64_t value;
+          if (i == 1) {
+            value = c;
+          } else if (c == 0) {
+            value = 0;
+          } else {
+            // C(c,i)=C(c-1,i)+C(c-1,i-1)
+            if (__builtin_add_overflow(
+                  binom(i, c - 1), binom(i - 1, c - 1), &value)) {
+              too_large();
+            }
+          }
+          m_binom[(i - 1) * N + c] = value;
+        }
+      }
+      m_factorial[0] = 1;
+      for (std::size_t i = 1; i <= K; ++i) {
+        m_factorial[i] = m_factorial[i - 1] * static_cast<double>(i);
+      }
+      // C(N,K)=C(N-1,K)+C(N-1,K-1)
+      if (N == 0) {
+        m_size = 0;
+      } else if (__builtin_add_overflow(
+                   binom(K, N - 1), K == 1 ? 1 : binom(K - 1, N - 1), &m_size)) {
+        too_large();
+      }
+    }
+  }
+
+  // the number of subsets, C(N,K)
+  std::uint64_t size() const { return m_size; }
+
+  // the subset with the given rank, in increasing order
+  Subset decode(std::uint64_t rank) const
+  {
+    Subset ret;
+    if constexpr (K == 2) {
+      // the largest c with c(c-1)/2 <= rank, from the quadratic formula
+      // and then corrected for rounding
+      auto c = static_cast<std::uint64_t>(
+        (1 + std::sqrt(1 + 8 * static_cast<double>(rank))) / 2);
+      while (binom2(c) > rank) {
+        --c;
+      }
+      while (binom2(c + 1) <= rank) {
+        ++c;
+      }
+      ret[1] = c;
+      ret[0] = rank - static_cast<std::uint64_t>(binom2(c));
+    } else {
+      std::uint64_t upper = m_N;
+      for (std::size_t i = K; i > 1; --i) {
+        // largest c in [i-1,upper) with C(c,i) <= rank. C(c,i) is close
+        // to (c-(i-1)/2)^i/i! which gives a guess, that is then corrected
+        // by stepping in the table.
+        const std::uint64_t* row = &m_binom[(i - 1) * m_N];
+        const double guess =
+          std::pow(static_cast<double>(rank) * m_factorial[i], 1.0 / i) +
+          0.5 * (i - 1);
+        std::uint64_t c = std::clamp<std::uint64_t>(
+          static_cast<std::uint64_t>(guess), i - 1, upper - 1);
+        while (row[c] > rank) {
+          --c;
+        }
+        while (c + 1 < upper && row[c + 1] <= rank) {
+          ++c;
+        }
+        ret[i - 1] = c;
+        rank -= row[c];
+        upper = c;
+      }
+      // C(c,1)=c
+      ret[0] = rank;
+    }
+    return ret;
+  }
+
+private:
+  static unsigned __int128 binom2(std::uint64_t c)
+  {
+    return c < 2 ? 0 : static_cast<unsigned __int128>(c) * (c - 1) / 2;
+  }
+  static std::uint64_t checked_binom2(std::uint64_t N)
+  {
+    const auto ret = binom2(N);
+    if (ret > std::numeric_limits<std::uint64_t>::max()) {
+      too_large();
+    }
+    return static_cast<std::uint64_t>(ret);
+  }
+  [[noreturn]] static void too_large()
+  {
+    std::puts("the number of combinations does not fit in 64 bits");
+    std::abort();
+  }
+  std::uint64_t binom(std::size_t i, std::uint64_t c) const
+  {
+    return m_binom[(i - 1) * m_N + c];
+  }
+
+  std::uint64_t m_N;
+  std::uint64_t m_size;
+  std::vector<std::uint64_t> m_binom;
+  std::array<double, K + 1> m_factorial;
+};
+
+/**
+ * invokes cb once with each K-subset of [0,N) in random order. The subset
+ * is passed as a std::array in increasing order.
+ */
+template<typename Crypto,
+         std::size_t K,
+         typename URBG,
+         typename Callback>
+void
+combinations_for_each(const CombinationSpace<K>& space,
+                      URBG&& rng,
+                      Callback&& cb)
+{
+  crypto_for_each<Crypto>(
+    space.size(), rng, [&](std::uint64_t rank) { cb(space.decode(rank)); });
+}
+
+/**
+ * invokes cb once with each ordered pair (i,j) of [0,N) with i!=j,
+ * in random order.
+ */
+template<typename Crypto, typename URBG, typename Callback>
+void
+ordered_pairs_for_each(std::uint64_t N, URBG&& rng, Callback&& cb)
+{
+  if (N < 2) {
+    return;
+  }
+  std::uint64_t M;
+  if (__builtin_mul_overflow(N, N - 1, &M)) {
+    std::puts("the number of pairs does not fit in 64 bits");
+    std::abort();
+  }
+  const FastDivider64 divider(N - 1);
+  crypto_for_each<Crypto>(M, rng, [&](std::uint64_t rank) {
+    const std::uint64_t i = divider.divide(rank);
+    std::uint64_t j = rank - i * (N - 1);
+    // skip the diagonal
+    j += (j >= i);
+    cb(std::array<std::uint64_t, 2>{ { i, j } });
+  });
+}
@@ -0,0 +1,238 @@
+/*
+ * By Paul Dreik 2019,2020
+ * https://www.pauldreik.se/
+ * License: Boost 1.0
+ * SPDX-License-Identifier: BSL-1.0
+ */
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <immintrin.h>
+#include <vector>
+
+/**
+ * @brief The CompressedBitmap class
+ * A set of 32 bit values, organized like a roaring bitmap: the values are
+ * grouped by their upper 16 bits, and each group is stored as a sorted
+ * array of the lower 16 bits while it is small, and as a 2^16 bit bitmap
+ * once it has more than ArrayMax values. This keeps both sparse and dense
+ * sets small.
+ *
+ * See https://roaringbitmap.org/ for the idea.
+ */
+class CompressedBitmap
+{
+public:
+  // above this many values, a container is converted into a bitmap
+  static constexpr std::size_t ArrayMax = 4096;
+  static constexpr std::size_t BitmapWords = 65536 / 64;
+
+  struct Container
+  {
+    // sorted, used while bitmap is empty
+    std::vector<std::uint16_t> array;
+    std::vector<std::uint64_t> bitmap;
+    std::uint32_t cardinality = 0;
+    bool is_bitmap() const { return !bitmap.empty(); }
+  };
+
+  /// adds x, returns false if it already was in the set
+  bool add(std::uint32_t x)
+  {
+    Container& c = container_for(static_cast<std::uint16_t>(x >> 16));
+    const auto low = static_cast<std::uint16_t>(x);
+    if (c.is_bitmap()) {
+      std::uint64_t& word = c.bitmap[low / 64];
+      const std::uint64_t bit = std::uint64_t{ 1 } << (low % 64);
+      if (word & bit) {
+        return false;
+      }
+      word |= bit;
+    } else {
+      auto it = std::lower_bound(c.array.begin(), c.array.end(), low);
+      if (it != c.array.end() && *it == low) {
+        return false;
+      }
+      c.array.insert(it, low);
+      if (c.array.size() > ArrayMax) {
+        c.bitmap.assign(BitmapWords, 0);
+        for (auto e : c.array) {
+          c.bitmap[e / 64] |= std::uint64_t{ 1 } << (e % 64);
+        }
+        c.array = {};
+      }
+    }
+    ++c.cardinality;
+    ++m_cardinality;
+    return true;
+  }
+
+  bool contains(std::uint32_t x) const
+  {
+    const auto key = static_cast<std::uint16_t>(x >> 16);
+    auto it = std::lower_bound(m_keys.begin(), m_keys.end(), key);
+    if (it == m_keys.end() || *it != key) {
+      return false;
+    }
+    return container_contains(m_containers[it - m_keys.begin()],
+                              static_cast<std::uint16_t>(x));
+  }
+
+  std::uint64_t cardinality() const { return m_cardinality; }
+
+  /// number of values less than x
+  std::uint64_t rank(std::uint64_t x) const
+  {
+    std::uint64_t ret = 0;
+    for (std::size_t i = 0; i < m_keys.size(); ++i) {
+      const std::uint64_t base = std::uint64_t{ m_keys[i] } << 16;
+      if (base >= x) {
+        break;
+      }
+      const Container& c = m_containers[i];
+      if (x - base >= 65536) {
+        ret += c.cardinality;
+      } else if (c.is_bitmap()) {
+        const auto low = static_cast<std::size_t>(x - base);
+        for (std::size_t w = 0; w < low / 64; ++w) {
+          ret += static_cast<std::uint64_t>(__builtin_popcountll(c.bitmap[w]));
+        }
+        if (low % 64 != 0) {
+          const std::uint64_t below = (std::uint64_t{ 1 } << (low % 64)) - 1;
+          ret += static_cast<std::uint64_t>(
+            __builtin_popcountll(c.bitmap[low / 64] & below));
+        }
+      } else {
+        ret += static_cast<std::uint64_t>(
+          std::lower_bound(c.array.begin(), c.array.end(), x - base) -
+          c.array.begin());
+      }
+    }
+    return ret;
+  }
+
+  const std::vector<std::uint16_t>& keys() const { return m_keys; }
+  const std::vector<Container>& containers() const { return m_containers; }
+
+  static bool container_contains(const Container& c, std::uint16_t low)
+  {
+    if (c.is_bitmap()) {
+      return (c.bitmap[low / 64] >> (low % 64)) & 1U;
+    }
+    return std::binary_search(c.array.begin(), c.array.end(), low);
+  }
+
+private:
+  Container& container_for(std::uint16_t key)
+  {
+    auto it = std::lower_bound(m_keys.begin(), m_keys.end(), key);
+    const auto index = it - m_keys.begin();
+    if (it == m_keys.end() || *it != key) {
+      m_keys.insert(it, key);
+      m_containers.insert(m_containers.begin() + index, Container{});
+    }
+    return m_containers[static_cast<std::size_t>(index)];
+  }
+
+  // sorted upper 16 bits, and the matching containers
+  std::vector<std::uint16_t> m_keys;
+  std::vector<Container> m_containers;
+  std::uint64_t m_cardinality = 0;
+};
+
+/**
+ * @brief The BitmapProbe class
+ * Fast membership tests of eight values at a time against a
+ * CompressedBitmap, which must outlive the probe and not be modified.
+ *
+ * A directory indexed by the upper 16 bits tells where the bitmap words of
+ * each container are, so the bitmap containers are probed with two
+ * gathers. Lanes that hit an array container are looked up one by one.
+ */
+class BitmapProbe
+{
+public:
+  explicit BitmapProbe(const CompressedBitmap& bitmap)
+    : m_bitmap(bitmap)
+    , m_dir(65536, Empty)
+  {
+    const auto& keys = bitmap.keys();
+    const auto& containers = bitmap.containers();
+    for (std::size_t i = 0; i < keys.size(); ++i) {
+      const auto& c = containers[i];
+      if (c.is_bitmap()) {
+        m_dir[keys[i]] = static_cast<std::int32_t>(m_words.size());
+        for (auto w : c.bitmap) {
+          m_words.push_back(static_cast<std::uint32_t>(w));
+          m_words.push_back(static_cast<std::uint32_t>(w >> 32));
+        }
+      } else {
+        m_dir[keys[i]] = -2 - static_cast<std::int32_t>(i);
+      }
+    }
+    // gathers need a valid base address
+    m_words.push_back(0);
+  }
+
+  bool contains(std::uint32_t x) const
+  {
+    const std::int32_t entry = m_dir[x >> 16];
+    if (entry >= 0) {
+      return (m_words[entry + ((x & 0xFFFF) >> 5)] >> (x & 31)) & 1U;
+    }
+    if (entry == Empty) {
+      return false;
+    }
+    return CompressedBitmap::container_contains(
+      m_bitmap.containers()[static_cast<std::size_t>(-2 - entry)],
+      static_cast<std::uint16_t>(x));
+  }
+
+  /// bit i of the result is set if lane i of x is in the set
+  unsigned contains(__m256i x) const
+  {
+    const __m256i entry =
+      _mm256_i32gather_epi32(m_dir.data(), _mm256_srli_epi32(x, 16), 4);
+    const __m256i minus_one = _mm256_set1_epi32(-1);
+    const __m256i is_bitmap = _mm256_cmpgt_epi32(entry, minus_one);
+    const __m256i index = _mm256_add_epi32(
+      entry,
+      _mm256_srli_epi32(_mm256_and_si256(x, _mm256_set1_epi32(0xFFFF)), 5));
+    const __m256i words =
+      _mm256_mask_i32gather_epi32(_mm256_setzero_si256(),
+                                  (const int*)m_words.data(),
+                                  index,
+                                  is_bitmap,
+                                  4);
+    const __m256i bit = _mm256_srlv_epi32(
+      words, _mm256_and_si256(x, _mm256_set1_epi32(31)));
+    const __m256i hit =
+      _mm256_slli_epi32(_mm256_and_si256(bit, _mm256_set1_epi32(1)), 31);
+    unsigned mask = static_cast<unsigned>(
+      _mm256_movemask_ps(_mm256_castsi256_ps(hit)));
+    // the lanes with an array container, entry < -1
+    unsigned arrays = static_cast<unsigned>(_mm256_movemask_ps(
+      _mm256_castsi256_ps(_mm256_cmpgt_epi32(minus_one, entry))));
+    if (arrays != 0) {
+      alignas(32) std::uint32_t lanes[8];
+      _mm256_store_si256((__m256i*)lanes, x);
+      for (; arrays != 0; arrays &= arrays - 1) {
+        const int lane = __builtin_ctz(arrays);
+        if (contains(lanes[lane])) {
+          mask |= 1U << lane;
+        }
+      }
+    }
+    return mask;
+  }
+
+private:
+  static constexpr std::int32_t Empty = -1;
+  const CompressedBitmap& m_bitmap;
+  // per upper 16 bits: Empty, the offset into m_words for a bitmap
+  // container, or -2-index for an array container
+  std::vector<std::int32_t> m_dir;
+  std::vector<std::uint32_t> m_words;
+};
@@ -0,0 +1,81 @@
+/*
+ * By Paul Dreik 2019,2020
+ * https://www.pauldreik.se/
+ * License: Boost 1.0
+ * SPDX-License-Identifier: BSL-1.0
+ */
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <type_traits>
+
+#include "CryptoForEach.h"
+
+/**
+ * @brief The SplitMix64 class
+ * The splitmix64 generator by Sebastiano Vigna, see
+ * http://prng.di.unimi.it/splitmix64.c . It satisfies
+ * UniformRandomBitGenerator and is usable in constant expressions, so it
+ * can seed a cipher at compile time.
+ */
+class SplitMix64
+{
+public:
+  using result_type = std::uint64_t;
+  constexpr explicit SplitMix64(std::uint64_t seed = 0)
+    : m_state(seed)
+  {}
+  static constexpr result_type min() { return 0; }
+  static constexpr result_type max()
+  {
+    return std::numeric_limits<result_type>::max();
+  }
+  constexpr result_type operator()()
+  {
+    std::uint64_t z = (m_state += 0x9e3779b97f4a7c15);
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111eb;
+    return z ^ (z >> 31);
+  }
+
+private:
+  std::uint64_t m_state;
+};
+
+/**
+ * the values [0,N) in the order crypto_for_each<Crypto>(N, SplitMix64(seed),
+ * cb) visits them. Works in constant evaluation, for ciphers with
+ * constexpr constructor, seed and round function (Dynamic32, Dynamic64):
+ *
+ *   constexpr auto table = make_permutation<Dynamic32, 4096>(seed);
+ *
+ * The compiler limits the work done in constant evaluation, so keep N
+ * small, at most 2^16 or so. The elements are the smallest unsigned type
+ * of 16, 32 or 64 bits that holds N-1.
+ */
+template<typename Crypto, std::size_t N>
+constexpr auto
+make_permutation(std::uint64_t seed)
+{
+  using Value = std::conditional_t<
+    (N <= 0x10000),
+    std::uint16_t,
+    std::conditional_t<(N <= 0x100000000), std::uint32_t, std::uint64_t>>;
+  std::array<Value, N> table{};
+  if constexpr (N > 0) {
+    Crypto cipher(even_bits_needed(std::uint64_t{ N }));
+    SplitMix64 rng(seed);
+    cipher.seed(rng);
+    std::size_t count = 0;
+    for (std::uint64_t i = 0; count < N; ++i) {
+      const auto encrypted = cipher.encrypt(i);
+      if (encrypted < N) {
+        table[count++] = static_cast<Value>(encrypted);
+      }
+    }
+  }
+  return table;
+}
@@ -0,0 +1,204 @@
+/*
+ * By Paul Dreik 2019,2020
+ * https://www.pauldreik.se/
+ * License: Boost 1.0
+ * SPDX-License-Identifier: BSL-1.0
+ */
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <immintrin.h>
+#include <limits>
+#include <random>
+#include <type_traits>
+#include <utility>
+
+#include "Feistel128.h"
+#include "Fnv1aCiphers.h"
+#include "MurmurCryptFixed64.h"
+
+namespace CounterRngInternals {
+/**
+ * fnv1a on the four bytes of each 32 bit lane, same as
+ * DynamicInternals::hashfnv1a(std::uint32_t)
+ */
+inline __m256i
+hashfnv1a(__m256i value)
+{
+  const __m256i prime = _mm256_set1_epi32(0x1000193);
+  const __m256i bytemask = _mm256_set1_epi32(0xFF);
+  __m256i hash = _mm256_set1_epi32(0x811c9dc5);
+  hash = _mm256_xor_si256(hash, _mm256_and_si256(value, bytemask));
+  hash = _mm256_mullo_epi32(hash, prime);
+  hash = _mm256_xor_si256(
+    hash, _mm256_and_si256(_mm256_srli_epi32(value, 8), bytemask));
+  hash = _mm256_mullo_epi32(hash, prime);
+  hash = _mm256_xor_si256(
+    hash, _mm256_and_si256(_mm256_srli_epi32(value, 16), bytemask));
+  hash = _mm256_mullo_epi32(hash, prime);
+  hash = _mm256_xor_si256(hash, _mm256_srli_epi32(value, 24));
+  hash = _mm256_mullo_epi32(hash, prime);
+  return hash;
+}
+
+/**
+ * makes the 64 bit wide cipher used by CounterRng. Dynamic64 and the
+ * feistel ciphers take the bit width, MurmurCryptFixed64 is fixed.
+ */
+template<typename Crypto>
+Crypto
+make_cipher()
+{
+  if constexpr (std::is_constructible_v<Crypto, int>) {
+    return Crypto(64);
+  } else {
+    return Crypto{};
+  }
+}
+}
+
+/**
+ * @brief The CounterRng class
+ * A counter based random number generator: the n:th output is
+ * the keyed bijection Crypto applied to n. It satisfies
+ * UniformRandomBitGenerator, so it can be used with the std distributions.
+ *
+ * Since the state is just the key and a counter, discard() is O(1) and
+ * independent streams are had by partitioning the counter space, see
+ * split(). The output never repeats within 2^64 draws.
+ *
+ * Crypto must be a 64 bit wide cipher with seed(urbg), encrypt(uint64)
+ * and operator==, for instance Dynamic64, MurmurCryptFixed64 or
+ * Aes128Feistel.
+ */
+template<typename Crypto>
+class CounterRng
+{
+public:
+  using result_type = std::uint64_t;
+
+  /// number of counter bits each stream made by split() owns
+  static constexpr int StreamBits = 40;
+
+  explicit CounterRng(std::uint64_t seed = 0)
+    : m_cipher(CounterRngInternals::make_cipher<Crypto>())
+  {
+    this->seed(seed);
+  }
+
+  static constexpr result_type min() { return 0; }
+  static constexpr result_type max()
+  {
+    return std::numeric_limits<result_type>::max();
+  }
+
+  /// rekeys the cipher deterministically from seed and rewinds
+  void seed(std::uint64_t seed)
+  {
+    std::mt19937_64 rng(seed);
+    m_cipher.seed(rng);
+    m_counter = 0;
+  }
+
+  result_type operator()()
+  {
+    return static_cast<result_type>(m_cipher.encrypt(m_counter++));
+  }
+
+  /// skips n outputs, in constant time
+  void discard(unsigned long long n) { m_counter += n; }
+
+  /**
+   * returns a generator with the same key, positioned at the start of
+   * stream number stream. Streams 0,1,2... each own 2^StreamBits
+   * consecutive counters, so as long as no stream draws more than that,
+   * the streams never overlap. Typical use is one stream per thread.
+   */
+  CounterRng split(std::uint64_t stream) const
+  {
+    CounterRng ret(*this);
+    ret.m_counter = stream << StreamBits;
+    return ret;
+  }
+
+  /// the index of the next output
+  std::uint64_t counter() const { return m_counter; }
+
+  /**
+   * fills [first,last) with the next outputs. Gives the same values as
+   * calling operator() repeatedly, but is explicitly vectorized for
+   * Dynamic64.
+   */
+  void generate(result_type* first, result_type* last)
+  {
+    if constexpr (std::is_same_v<Crypto, Dynamic64>) {
+      first = generate_dynamic64(first, last);
+    }
+    // written without a loop carried counter, so the compiler
+    // vectorizes it for simple ciphers like MurmurCryptFixed64.
+    const std::ptrdiff_t n = last - first;
+    for (std::ptrdiff_t i = 0; i < n; ++i) {
+      first[i] = static_cast<result_type>(m_cipher.encrypt(m_counter + i));
+    }
+    m_counter += n;
+  }
+
+  bool operator==(const CounterRng& other) const
+  {
+    return m_counter == other.m_counter && m_cipher == other.m_cipher;
+  }
+  bool operator!=(const CounterRng& other) const { return !(*this == other); }
+
+private:
+  /**
+   * does eight counters at a time, with the 32 bit halves in separate
+   * registers. the round function is that of Dynamic64, hash(right)^key.
+   */
+  result_type* generate_dynamic64(result_type* first, result_type* last)
+  {
+    using namespace CounterRngInternals;
+    if (last - first < 8) {
+      return first;
+    }
+    __m256i keys[Crypto::ROUNDS];
+    for (int round = 0; round < Crypto::ROUNDS; ++round) {
+      keys[round] = _mm256_set1_epi32(static_cast<int>(m_cipher.key(round)));
+    }
+    const __m256i offsets = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+    for (; last - first >= 8; first += 8, m_counter += 8) {
+      // the low halves of eight consecutive counters. if they wrap around
+      // the high half, fall back to the scalar code for this batch.
+      const std::uint32_t lo = static_cast<std::uint32_t>(m_counter);
+      const std::uint32_t hi = static_cast<std::uint32_t>(m_counter >> 32);
+      if (lo > 0xFFFFFFFFU - 7) {
+        for (int i = 0; i < 8; ++i) {
+          first[i] = m_cipher.encrypt(m_counter + i);
+        }
+        continue;
+      }
+      __m256i left = _mm256_set1_epi32(static_cast<int>(hi));
+      __m256i right =
+        _mm256_add_epi32(_mm256_set1_epi32(static_cast<int>(lo)), offsets);
+      for (int round = 0; round < Crypto::ROUNDS; ++round) {
+        const __m256i F = _mm256_xor_si256(hashfnv1a(right), keys[round]);
+        left = _mm256_xor_si256(left, F);
+        std::swap(left, right);
+      }
+      // undo the last swap, like GenericFeistel does
+      std::swap(left, right);
+      // interleave into 64 bit values and restore the order
+      const __m256i a = _mm256_unpacklo_epi32(right, left); // 0 1 4 5
+      const __m256i b = _mm256_unpackhi_epi32(right, left); // 2 3 6 7
+      _mm256_storeu_si256((__m256i*)first,
+                          _mm256_permute2x128_si256(a, b, 0x20));
+      _mm256_storeu_si256((__m256i*)(first + 4),
+                          _mm256_permute2x128_si256(a, b, 0x31));
+    }
+    return first;
+  }
+
+  Crypto m_cipher;
+  std::uint64_t m_counter = 0;
+};
@@ -0,0 +1,409 @@
+#pragma once
+/*
+ * By Paul Dreik 2019,2020
+ * https://www.pauldreik.se/
+ * License: Boost 1.0
+ * SPDX-License-Identifier: BSL-1.0
+ */
+#include <array>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <utility>
+
+#include "BitslicedFeistel.h"
+#include "ForEachStats.h"
+#include "ManyU32.h"
+#include "murmur32.h"
+#include "simdfeistel.h"
+
+/**
+ * number of bits needed to represent all values in [0,M), that is
+ * ceil(log2(M)). done with integers, since std::log2 rounds for large M.
+ */
+template<typename Integer>
+constexpr int
+bits_needed(Integer M)
+{
+  int bits = 0;
+  while (bits < static_cast<int>(8 * sizeof(Integer)) &&
+         (M - 1) >> bits != 0) {
+    ++bits;
+  }
+  return M == 0 ? 0 : bits;
+}
+
+/**
+ * like bits_needed, but rounded up to even since the feistel ciphers
+ * split the block in two equal halves.
+ */
+template<typename Integer>
+constexpr int
+even_bits_needed(Integer M)
+{
+  const int bits = bits_needed(M);
+  return bits + (bits % 2);
+}
+
+/**
+ * the largest block size in bits the cipher can handle, given by the type
+ * encrypt returns.
+ */
+template<typename Crypto>
+constexpr int
+cipher_bits()
+{
+  return 8 * sizeof(decltype(std::declval<Crypto&>().encrypt(0)));
+}
+
+/**
+ * keeps the last Lookahead values found by a driver, so they can be
+ * prefetched Lookahead steps before they are handed to the callback.
+ */
+template<typename Integer, int Lookahead>
+class LookaheadQueue
+{
+public:
+  static_assert(Lookahead > 0 && (Lookahead & (Lookahead - 1)) == 0,
+                "Lookahead must be a power of two");
+
+  template<typename Callback, typename Prefetch>
+  void push(Integer value, Callback& cb, Prefetch& prefetch)
+  {
+    prefetch(value);
+    auto& slot = m_pending[m_found % Lookahead];
+    if (m_found >= Lookahead) {
+      cb(slot);
+    }
+    slot = value;
+    ++m_found;
+  }
+
+  // delivers what is left once the cipher is done
+  template<typename Callback>
+  void drain(Callback& cb)
+  {
+    const Integer first = m_found > Lookahead ? m_found - Lookahead : 0;
+    for (Integer i = first; i < m_found; ++i) {
+      cb(m_pending[i % Lookahead]);
+    }
+  }
+
+  // number of values pushed so far (including the ones not delivered yet)
+  Integer found() const { return m_found; }
+
+private:
+  std::array<Integer, Lookahead> m_pending;
+  Integer m_found = 0;
+};
+
+/**
+ * block cipher based visitation of each integer exactly
+ * once
+ */
+template<typename Crypto, typename Integer, typename URBG, typename Callback>
+void
+crypto_for_each(Integer M, URBG&& rng, Callback&& cb)
+{
+  if (M == 0) {
+    return;
+  }
+  // how many bits do we need?
+  const int bitsneeded = even_bits_needed(M);
+
+  if (bitsneeded <= cipher_bits<Crypto>()) {
+    Crypto cipher(bitsneeded);
+    // auto s=sizeof(cipher);
+    cipher.seed(rng);
+    DefaultStatsRecorder stats;
+    Integer count = 0;
+    for (Integer i = 0; count < M; ++i) {
+      auto encrypted = stats.encrypt(1, [&] { return cipher.encrypt(i); });
+      if (encrypted < M) {
+        stats.deliver(cb, encrypted);
+        ++count;
+      }
+    }
+    return;
+  }
+  std::puts("implement switching to 64 bit");
+  std::abort();
+}
+
+/**
+ * runs the counters [begin,end) through an already seeded cipher and
+ * invokes cb(counter, value) for the values below M. The cipher must be
+ * of width even_bits_needed(M), and consecutive ranges covering
+ * [0,2^width) visit [0,M) exactly once. This makes it possible to split
+ * a run in pieces, or resume it from a known counter.
+ */
+template<typename Crypto, typename Integer, typename Callback>
+void
+crypto_for_each_range(Crypto& cipher,
+                      Integer M,
+                      Integer begin,
+                      Integer end,
+                      Callback&& cb)
+{
+  DefaultStatsRecorder stats;
+  Integer i = begin;
+  auto deliver = [&](Integer value) { cb(i, value); };
+  for (; i < end; ++i) {
+    const auto encrypted = stats.encrypt(1, [&] { return cipher.encrypt(i); });
+    if (encrypted < M) {
+      stats.deliver(deliver, static_cast<Integer>(encrypted));
+    }
+  }
+}
+
+/**
+ * like crypto_for_each, but the cipher runs Lookahead values ahead of
+ * the callback. prefetch(v) is invoked as soon as v is known, which is
+ * Lookahead invocations of cb before cb(v). This is useful when cb
+ * accesses memory depending on v, like &data[v], since the memory latency
+ * can be hidden with a software prefetch.
+ */
+template<typename Crypto,
+         int Lookahead,
+         typename Integer,
+         typename URBG,
+         typename Callback,
+         typename Prefetch>
+void
+crypto_for_each(Integer M, URBG&& rng, Callback&& cb, Prefetch&& prefetch)
+{
+  if (M == 0) {
+    return;
+  }
+  const int bitsneeded = even_bits_needed(M);
+
+  if (bitsneeded <= cipher_bits<Crypto>()) {
+    Crypto cipher(bitsneeded);
+    cipher.seed(rng);
+    DefaultStatsRecorder stats;
+    auto deliver = [&](Integer value) { stats.deliver(cb, value); };
+    LookaheadQueue<Integer, Lookahead> queue;
+    for (Integer i = 0; queue.found() < M; ++i) {
+      auto encrypted = stats.encrypt(1, [&] { return cipher.encrypt(i); });
+      if (encrypted < M) {
+        queue.push(encrypted, deliver, prefetch);
+      }
+    }
+    queue.drain(deliver);
+    return;
+  }
+  std::puts("implement switching to 64 bit");
+  std::abort();
+}
+
+/**
+ * runs the simd cipher SimdCrypto over [0,M), with the lanes of
+ * SimdCrypto::Vec encrypting consecutive counters.
+ */
+template<typename SimdCrypto,
+         typename Integer,
+         typename URBG,
+         typename Callback>
+void
+simd_crypto_for_each(Integer M, int bits, URBG&& rng, Callback& cb)
+{
+  using Vec = typename SimdCrypto::Vec;
+  SimdCrypto cipher(bits);
+  cipher.seed(rng);
+  DefaultStatsRecorder stats;
+  Vec II = Vec::iota();
+  const Vec lanes(Vec::size());
+  for (Integer count = 0; count < M; II += lanes) {
+    auto ea = stats.encrypt(Vec::size(),
+                            [&] { return cipher.encrypt(II).toArray(); });
+    for (auto encrypted : ea) {
+      if (encrypted < M) {
+        stats.deliver(cb, static_cast<Integer>(encrypted));
+        ++count;
+        if (count >= M) {
+          return;
+        }
+      }
+    }
+  }
+}
+
+/**
+ * like feistel_for_each, but simd parallelized. The lane width is picked
+ * from M, so small ranges get 16 lanes and ranges beyond 2^32 get 4.
+ */
+template<typename Integer, typename URBG, typename Callback>
+void
+simdfeistel_for_each(Integer M, URBG&& rng, Callback&& cb)
+{
+  if (M == 0) {
+    return;
+  }
+  // how many bits do we need?
+  const int bitsneeded = even_bits_needed(M);
+
+  if (bitsneeded <= 16) {
+    simd_crypto_for_each<ParallelFeistel16>(M, bitsneeded, rng, cb);
+  } else if (bitsneeded <= 32) {
+    simd_crypto_for_each<ParallelFeistel>(M, bitsneeded, rng, cb);
+  } else {
+    simd_crypto_for_each<ParallelFeistel64>(M, bitsneeded, rng, cb);
+  }
+}
+
+/**
+ * like simdfeistel_for_each, but with BitslicedFeistel which encrypts 256
+ * counters at a time. Ranges beyond 2^32 are left to simdfeistel_for_each.
+ */
+template<typename Integer, typename URBG, typename Callback>
+void
+bitsliced_for_each(Integer M, URBG&& rng, Callback&& cb)
+{
+  if (M == 0) {
+    return;
+  }
+  const int bitsneeded = even_bits_needed(M);
+  if (bitsneeded > 32) {
+    simdfeistel_for_each(M, rng, cb);
+    return;
+  }
+  // the halves must have at least one bit
+  const int bits = bitsneeded < 2 ? 2 : bitsneeded;
+  constexpr int L = BitslicedFeistel::Lanes;
+  BitslicedFeistel cipher(bits);
+  cipher.seed(rng);
+  DefaultStatsRecorder stats;
+  const std::uint64_t counters = std::uint64_t{ 1 } << bits;
+  std::uint32_t values[L];
+  Integer count = 0;
+  for (std::uint64_t base = 0; base < counters; base += L) {
+    const int n = counters - base < L ? static_cast<int>(counters - base) : L;
+    stats.encrypt(
+      n, [&] { cipher.encrypt256(static_cast<std::uint32_t>(base), values); });
+    for (int i = 0; i < n; ++i) {
+      if (values[i] < M) {
+        stats.deliver(cb, static_cast<Integer>(values[i]));
+        if (++count >= M) {
+          return;
+        }
+      }
+    }
+  }
+}
+
+template<typename Integer, typename URBG, typename Callback>
+void
+simdmurmur_for_each(Integer M, URBG&& rng, Callback&& cb)
+{
+  if (M == 0) {
+    return;
+  }
+  // how many bits do we need?
+  const int bitsneeded = bits_needed(M);
+
+  if (bitsneeded <= 16) {
+    simd_crypto_for_each<SimdMurmur16>(M, bitsneeded, rng, cb);
+  } else if (bitsneeded <= 32) {
+    simd_crypto_for_each<SimdMurmur32>(M, bitsneeded, rng, cb);
+  } else {
+    simd_crypto_for_each<SimdMurmur64>(M, bitsneeded, rng, cb);
+  }
+}
+
+/**
+ * runs a simd cipher over [0,M), invoking the prefetch hook Lookahead
+ * values ahead of cb. see crypto_for_each with prefetch.
+ */
+template<int Lookahead,
+         typename SimdCrypto,
+         typename Integer,
+         typename Callback,
+         typename Prefetch>
+void
+simd_for_each_prefetch(SimdCrypto& cipher,
+                       Integer M,
+                       Callback& cb,
+                       Prefetch& prefetch)
+{
+  DefaultStatsRecorder stats;
+  auto deliver = [&](Integer value) { stats.deliver(cb, value); };
+  LookaheadQueue<Integer, Lookahead> queue;
+  using Vec = typename SimdCrypto::Vec;
+  Vec II = Vec::iota();
+  const Vec lanes(Vec::size());
+  for (; queue.found() < M; II += lanes) {
+    auto ea = stats.encrypt(Vec::size(),
+                            [&] { return cipher.encrypt(II).toArray(); });
+    for (auto encrypted : ea) {
+      if (encrypted < M) {
+        queue.push(static_cast<Integer>(encrypted), deliver, prefetch);
+        if (queue.found() >= M) {
+          break;
+        }
+      }
+    }
+  }
+  queue.drain(deliver);
+}
+
+/**
+ * simdfeistel_for_each with a prefetch hook, see crypto_for_each
+ */
+template<int Lookahead,
+         typename Integer,
+         typename URBG,
+         typename Callback,
+         typename Prefetch>
+void
+simdfeistel_for_each(Integer M, URBG&& rng, Callback&& cb, Prefetch&& prefetch)
+{
+  if (M == 0) {
+    return;
+  }
+  const int bitsneeded = even_bits_needed(M);
+
+  if (bitsneeded <= 16) {
+    ParallelFeistel16 cipher(bitsneeded);
+    cipher.seed(rng);
+    simd_for_each_prefetch<Lookahead>(cipher, M, cb, prefetch);
+  } else if (bitsneeded <= 32) {
+    ParallelFeistel cipher(bitsneeded);
+    cipher.seed(rng);
+    simd_for_each_prefetch<Lookahead>(cipher, M, cb, prefetch);
+  } else {
+    ParallelFeistel64 cipher(bitsneeded);
+    cipher.seed(rng);
+    simd_for_each_prefetch<Lookahead>(cipher, M, cb, prefetch);
+  }
+}
+
+/**
+ * simdmurmur_for_each with a prefetch hook, see crypto_for_each
+ */
+template<int Lookahead,
+         typename Integer,
+         typename URBG,
+         typename Callback,
+         typename Prefetch>
+void
+simdmurmur_for_each(Integer M, URBG&& rng, Callback&& cb, Prefetch&& prefetch)
+{
+  if (M == 0) {
+    return;
+  }
+  const int bitsneeded = bits_needed(M);
+
+  if (bitsneeded <= 16) {
+    SimdMurmur16 cipher(bitsneeded);
+    cipher.seed(rng);
+    simd_for_each_prefetch<Lookahead>(cipher, M, cb, prefetch);
+  } else if (bitsneeded <= 32) {
+    SimdMurmur32 cipher(bitsneeded);
+    cipher.seed(rng);
+    simd_for_each_prefetch<Lookahead>(cipher, M, cb, prefetch);
+  } else {
+    SimdMurmur64 cipher(bitsneeded);
+    cipher.seed(rng);
+    simd_for_each_prefetch<Lookahead>(cipher, M, cb, prefetch);
+  }
+}
@@ -0,0 +1,114 @@
+/*
+ * By Paul Dreik 2019,2020
+ * https://www.pauldreik.se/
+ * License: Boost 1.0
+ * SPDX-License-Identifier: BSL-1.0
+ */
+#pragma once
+
+#include <cassert>
+#include <cstdint>
+#include <immintrin.h>
+#include <vector>
+
+#include "CompressedBitmap.h"
+#include "CryptoForEach.h"
+#include "simdfeistel.h"
+
+/**
+ * values in [0,M) that tend to trigger bugs, most likely first: the ends
+ * of the range, then the powers of two and their neighbours, which is where
+ * overflows and off by one errors in size and sign handling show up.
+ * There are no duplicates.
+ */
+inline std::vector<std::uint32_t>
+interesting_values(std::uint64_t M)
+{
+  assert(M <= (std::uint64_t{ 1 } << 32));
+  std::vector<std::uint64_t> candidates{ 0, 1, M - 1, 2, M - 2 };
+  for (int shift = 2; shift < 64 && (std::uint64_t{ 1 } << shift) <= M;
+       ++shift) {
+    const std::uint64_t p = std::uint64_t{ 1 } << shift;
+    candidates.push_back(p - 1);
+    candidates.push_back(p);
+    candidates.push_back(p + 1);
+  }
+  std::vector<std::uint32_t> ret;
+  CompressedBitmap seen;
+  for (auto c : candidates) {
+    // M - 1 and M - 2 wrap around for small M
+    if (c < M && seen.add(static_cast<std::uint32_t>(c))) {
+      ret.push_back(static_cast<std::uint32_t>(c));
+    }
+  }
+  return ret;
+}
+
+/**
+ * visits [0,M) except the values in excluded, with the values in prelude
+ * first (in the given order) and then the rest in random order. Nothing is
+ * visited twice, prelude values that are excluded or outside the range are
+ * skipped. M may be at most 2^32.
+ *
+ * excluded is taken by value, since the prelude is added to it. Move it in
+ * if it is large and not needed afterwards.
+ *
+ * The random part runs ParallelFeistel like simdfeistel_for_each, and
+ * removes the excluded values eight at a time with a BitmapProbe.
+ */
+template<typename URBG, typename Callback>
+void
+excluding_for_each(std::uint64_t M,
+                   URBG&& rng,
+                   CompressedBitmap excluded,
+                   const std::vector<std::uint32_t>& prelude,
+                   Callback&& cb)
+{
+  assert(M <= (std::uint64_t{ 1 } << 32));
+  DefaultStatsRecorder stats;
+  for (auto value : prelude) {
+    if (value < M && excluded.add(value)) {
+      stats.deliver(cb, value);
+    }
+  }
+  const std::uint64_t remaining = M - excluded.rank(M);
+  if (remaining == 0) {
+    return;
+  }
+
+  ParallelFeistel cipher(even_bits_needed(M));
+  cipher.seed(rng);
+  const BitmapProbe probe(excluded);
+
+  // unsigned comparison through signed, by flipping the sign bit
+  const __m256i flip = _mm256_set1_epi32(static_cast<int>(0x80000000U));
+  const __m256i limit = _mm256_xor_si256(
+    _mm256_set1_epi32(static_cast<int>(static_cast<std::uint32_t>(M))), flip);
+  const bool everything = M == (std::uint64_t{ 1 } << 32);
+
+  ManyU32 II = ManyU32::iota();
+  const ManyU32 lanes(8);
+  std::uint64_t count = 0;
+  for (;; II += lanes) {
+    const __m256i x = stats.encrypt(8, [&] { return cipher.encrypt(II).m_x; });
+    unsigned mask = 0xFF;
+    if (!everything) {
+      const __m256i inrange =
+        _mm256_cmpgt_epi32(limit, _mm256_xor_si256(x, flip));
+      mask = static_cast<unsigned>(
+        _mm256_movemask_ps(_mm256_castsi256_ps(inrange)));
+    }
+    mask &= ~probe.contains(x);
+    if (mask == 0) {
+      continue;
+    }
+    alignas(32) std::uint32_t values[8];
+    _mm256_store_si256((__m256i*)values, x);
+    for (; mask != 0; mask &= mask - 1) {
+      stats.deliver(cb, values[__builtin_ctz(mask)]);
+      if (++count == remaining) {
+        return;
+      }
+    }
+  }
+}
@@ -0,0 +1,136 @@
+/*
+ * By Paul Dreik 2019,2020
+ * https://www.pauldreik.se/
+ * License: Boost 1.0
+ * SPDX-License-Identifier: BSL-1.0
+ */
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <wmmintrin.h> //for intrinsics for AES-NI
+
+#include "GenericFeistel.h"
+
+/**
+ * 128 bit block type for the ciphers in this file (gcc and clang extension)
+ */
+using uint128 = unsigned __int128;
+
+/**
+ * @brief The Aes128Feistel class
+ * A block cipher with dynamic even bit width <=128, using 64 bit halves.
+ * This covers domains larger than 2^64, like pairs of 64 bit operands.
+ *
+ * The round function uses the AES hw support. The half is put in both
+ * 64 bit lanes and run through two aes rounds, so each bit of the result
+ * depends on all input bytes.
+ */
+template<int ROUNDS_>
+class Aes128Feistel
+  : public GenericFeistel<Aes128Feistel<ROUNDS_>, uint128, std::uint64_t>
+{
+public:
+  static constexpr int ROUNDS = ROUNDS_;
+  using Base = GenericFeistel<Aes128Feistel<ROUNDS>, uint128, std::uint64_t>;
+  explicit Aes128Feistel(int Nbits)
+    : Base(Nbits)
+  {}
+
+  template<typename URBG>
+  void seed(URBG& urbg)
+  {
+    for (auto& key : m_key) {
+      std::uint32_t seedarray[4];
+      for (auto& e : seedarray) {
+        e = urbg();
+      }
+      key = _mm_loadu_si128((__m128i*)seedarray);
+    }
+  }
+
+  std::uint64_t roundFunction(const std::uint64_t x, int round) const
+  {
+    __m128i m = _mm_set1_epi64x(static_cast<long long>(x));
+    m = _mm_aesenc_si128(m, m_key[round]);
+    m = _mm_aesenc_si128(m, m_key[round]);
+    return static_cast<std::uint64_t>(_mm_cvtsi128_si64(m));
+  }
+
+  /// the aes round key of the given round
+  __m128i key(int round) const { return m_key[round]; }
+
+  bool operator==(const Aes128Feistel& other) const
+  {
+    if (this->bits() != other.bits()) {
+      return false;
+    }
+    for (int round = 0; round < ROUNDS; ++round) {
+      const __m128i eq = _mm_cmpeq_epi8(m_key[round], other.m_key[round]);
+      if (_mm_movemask_epi8(eq) != 0xFFFF) {
+        return false;
+      }
+    }
+    return true;
+  }
+  bool operator!=(const Aes128Feistel& other) const
+  {
+    return !(*this == other);
+  }
+
+private:
+  __m128i m_key[ROUNDS];
+};
+
+/**
+ * @brief The MulXorFeistel128 class
+ * Like Aes128Feistel, but with a multiply-xorshift round function (the
+ * finalizer from murmur3/splitmix64 applied to the keyed half), for
+ * machines without aes support.
+ */
+template<int ROUNDS_>
+class MulXorFeistel128
+  : public GenericFeistel<MulXorFeistel128<ROUNDS_>, uint128, std::uint64_t>
+{
+public:
+  static constexpr int ROUNDS = ROUNDS_;
+  using Base = GenericFeistel<MulXorFeistel128<ROUNDS>, uint128, std::uint64_t>;
+  explicit MulXorFeistel128(int Nbits)
+    : Base(Nbits)
+  {}
+
+  template<typename URBG>
+  void seed(URBG&& urbg)
+  {
+    for (auto& e : m_key) {
+      e = urbg();
+      e = (e << 32) ^ urbg();
+    }
+  }
+
+  std::uint64_t roundFunction(std::uint64_t x, int round) const
+  {
+    x ^= m_key[round];
+    x ^= x >> 33;
+    x *= 0xff51afd7ed558ccd;
+    x ^= x >> 33;
+    x *= 0xc4ceb9fe1a85ec53;
+    x ^= x >> 33;
+    return x;
+  }
+
+  /// the key xored onto the half in the given round
+  std::uint64_t key(int round) const { return m_key[round]; }
+
+  bool operator==(const MulXorFeistel128& other) const
+  {
+    return this->bits() == other.bits() && m_key == other.m_key;
+  }
+  bool operator!=(const MulXorFeistel128& other) const
+  {
+    return !(*this == other);
+  }
+
+private:
+  std::array<std::uint64_t, ROUNDS> m_key;
+};
@@ -15,7 +15,7 @@ namespace {
  * internals for the ciphers further down this file
  */
 namespace DynamicInternals {
-std::uint16_t
+constexpr std::uint16_t
 hashfnv1a(const std::uint16_t value)
 {
   const std::uint32_t prime = 0x1000193;
@@ -30,7 +30,7 @@ hashfnv1a(const std::uint16_t value)
   return hash ^ (hash >> 16);
 }
 
-std::uint32_t
+constexpr std::uint32_t
 hashfnv1a(const std::uint32_t value)
 {
   const std::uint32_t prime = 0x1000193;
@@ -58,25 +58,35 @@ class Dynamic32 : public GenericFeistel<Dynamic32, std::uint32_t, std::uint16_t>
 public:
   static constexpr int ROUNDS = 2;
   using Base = GenericFeistel<Dynamic32, std::uint32_t, std::uint16_t>;
-  explicit Dynamic32(int Nbits)
+  constexpr explicit Dynamic32(int Nbits)
     : Base(Nbits)
   {}
 
   template<typename URBG>
-  void seed(URBG&& urbg)
+  constexpr void seed(URBG&& urbg)
   {
     for (auto& e : m_key) {
       e = urbg();
     }
   }
 
-  std::uint16_t roundFunction(const std::uint16_t x, int round) const
+  constexpr std::uint16_t roundFunction(const std::uint16_t x,
+                                        int round) const
   {
     return DynamicInternals::hashfnv1a(x) ^ m_key[round];
   }
 
+  /// the key xored onto the hash in the given round
+  constexpr std::uint16_t key(int round) const { return m_key[round]; }
+
+  bool operator==(const Dynamic32& other) const
+  {
+    return bits() == other.bits() && m_key == other.m_key;
+  }
+  bool operator!=(const Dynamic32& other) const { return !(*this == other); }
+
 private:
-  std::array<std::uint16_t, ROUNDS> m_key;
+  std::array<std::uint16_t, ROUNDS> m_key{};
 };
 
 /**
@@ -89,21 +99,31 @@ class Dynamic64 : public GenericFeistel<Dynamic64, std::uint64_t, std::uint32_t>
 public:
   static constexpr int ROUNDS = 2;
   using Base = GenericFeistel<Dynamic64, std::uint64_t, std::uint32_t>;
-  explicit Dynamic64(int Nbits)
+  constexpr explicit Dynamic64(int Nbits)
     : Base(Nbits)
   {}
   template<typename URBG>
-  void seed(URBG&& urbg)
+  constexpr void seed(URBG&& urbg)
   {
     for (auto& e : m_key) {
       e = urbg();
     }
   }
-  std::uint32_t roundFunction(const std::uint32_t x, int round) const
+  constexpr std::uint32_t roundFunction(const std::uint32_t x,
+                                        int round) const
   {
     return DynamicInternals::hashfnv1a(x) ^ m_key[round];
   }
 
+  /// the key xored onto the hash in the given round
+  constexpr std::uint32_t key(int round) const { return m_key[round]; }
+
+  bool operator==(const Dynamic64& other) const
+  {
+    return bits() == other.bits() && m_key == other.m_key;
+  }
+  bool operator!=(const Dynamic64& other) const { return !(*this == other); }
+
 private:
-  std::array<std::uint32_t, ROUNDS> m_key;
+  std::array<std::uint32_t, ROUNDS> m_key{};
 };
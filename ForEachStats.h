@@ -0,0 +1,251 @@
+#pragma once
+/*
+ * By Paul Dreik 2019,2020
+ * https://www.pauldreik.se/
+ * License: Boost 1.0
+ * SPDX-License-Identifier: BSL-1.0
+ */
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <cstdio>
+
+#include <x86intrin.h> // __rdtsc
+
+/*
+ * Instrumentation of the foreach drivers, enabled at compile time by
+ * defining RANDOM_FOREACH_STATS to 1 (see the cmake option with the same
+ * name). When disabled, the recorder is empty and compiles to nothing.
+ */
+#ifndef RANDOM_FOREACH_STATS
+#define RANDOM_FOREACH_STATS 0
+#endif
+
+/**
+ * what happened during one run of a driver. The cipher and the callback
+ * are timed on samples, fenced so they do not overlap with the
+ * surrounding code. That makes them latencies, while the total has the
+ * cipher, callback and driver overlapping in the pipeline, so the parts
+ * may well add up to more than the total.
+ */
+struct ForEachStats
+{
+  // every SampleInterval delivered value, the callback is timed
+  static constexpr std::uint64_t SampleInterval = 1024;
+
+  // number of values encrypted (for the simd drivers, lanes)
+  std::uint64_t encryptions = 0;
+  // number of values passed to the callback
+  std::uint64_t accepts = 0;
+  // encryptions that fell outside the range (cycle walking)
+  std::uint64_t rejects = 0;
+  // rdtsc cycles for the entire run
+  std::uint64_t cycles = 0;
+  // number of timed callbacks, and the cycles they took
+  std::uint64_t sampled = 0;
+  std::uint64_t sampled_callback_cycles = 0;
+  // encryptions in the timed calls to the cipher, and the cycles they took
+  std::uint64_t sampled_encryptions = 0;
+  std::uint64_t sampled_cipher_cycles = 0;
+  // histogram of the cycles taken between two samples (that is, to deliver
+  // SampleInterval values), bucket i holds counts in [2^i,2^(i+1))
+  std::array<std::uint64_t, 48> fill_histogram{};
+
+  double cycles_per_element() const
+  {
+    return accepts > 0 ? static_cast<double>(cycles) / accepts : 0.0;
+  }
+  // estimated from the sampled callbacks
+  double callback_cycles_per_element() const
+  {
+    return sampled > 0
+             ? static_cast<double>(sampled_callback_cycles) / sampled
+             : 0.0;
+  }
+  // estimated from the sampled cipher calls, including the rejects
+  double cipher_cycles_per_element() const
+  {
+    if (sampled_encryptions == 0 || accepts == 0) {
+      return 0.0;
+    }
+    return static_cast<double>(sampled_cipher_cycles) / sampled_encryptions *
+           encryptions / accepts;
+  }
+
+  void print(std::FILE* out) const
+  {
+    std::fprintf(out,
+                 "stats: %llu encryptions, %llu accepts, %llu rejects "
+                 "(%.1f%%), %.2f cycles/element (latency of cipher %.2f, "
+                 "callback %.2f)\n",
+                 static_cast<unsigned long long>(encryptions),
+                 static_cast<unsigned long long>(accepts),
+                 static_cast<unsigned long long>(rejects),
+                 encryptions > 0 ? 100.0 * rejects / encryptions : 0.0,
+                 cycles_per_element(),
+                 cipher_cycles_per_element(),
+                 callback_cycles_per_element());
+    std::fprintf(out, "stats: cycles per %llu values:",
+                 static_cast<unsigned long long>(SampleInterval));
+    for (std::size_t i = 0; i < fill_histogram.size(); ++i) {
+      if (fill_histogram[i] != 0) {
+        std::fprintf(out,
+                     " [2^%zu]=%llu",
+                     i,
+                     static_cast<unsigned long long>(fill_histogram[i]));
+      }
+    }
+    std::fprintf(out, "\n");
+  }
+};
+
+/**
+ * the stats of the last driver run finished on this thread. only updated
+ * when RANDOM_FOREACH_STATS is enabled.
+ */
+inline ForEachStats&
+last_foreach_stats()
+{
+  static thread_local ForEachStats stats;
+  return stats;
+}
+
+/**
+ * used by the drivers to record stats. The enabled version publishes to
+ * last_foreach_stats() when it goes out of scope.
+ */
+template<bool Enabled>
+class StatsRecorder;
+
+template<>
+class StatsRecorder<false>
+{
+public:
+  template<typename Encrypt>
+  decltype(auto) encrypt(std::uint64_t, Encrypt&& e)
+  {
+    return e();
+  }
+  template<typename Callback, typename Value>
+  void deliver(Callback& cb, const Value& value)
+  {
+    cb(value);
+  }
+};
+
+template<>
+class StatsRecorder<true>
+{
+public:
+  StatsRecorder()
+    : m_start(__rdtsc())
+    , m_last(m_start)
+  {}
+  StatsRecorder(const StatsRecorder&) = delete;
+  StatsRecorder& operator=(const StatsRecorder&) = delete;
+  ~StatsRecorder()
+  {
+    m_stats.cycles = __rdtsc() - m_start;
+    // accepts are not counted one by one, they follow from the countdown
+    m_stats.accepts = m_stats.sampled * ForEachStats::SampleInterval +
+                      (ForEachStats::SampleInterval - m_countdown);
+    m_stats.rejects = m_stats.encryptions - m_stats.accepts;
+    last_foreach_stats() = m_stats;
+  }
+
+  /**
+   * returns e(), which encrypts n values. Every SampleInterval call is
+   * timed, which is how the cipher cost is measured.
+   */
+  template<typename Encrypt>
+  decltype(auto) encrypt(std::uint64_t n, Encrypt&& e)
+  {
+    m_stats.encryptions += n;
+    if (--m_cipher_countdown != 0) {
+      return e();
+    }
+    m_cipher_countdown = ForEachStats::SampleInterval;
+    CipherTimer timer(m_stats, n);
+    return e();
+  }
+
+  template<typename Callback, typename Value>
+  void deliver(Callback& cb, const Value& value)
+  {
+    if (--m_countdown != 0) {
+      cb(value);
+      return;
+    }
+    m_countdown = ForEachStats::SampleInterval;
+    const std::uint64_t before = timestamp();
+    cb(value);
+    const std::uint64_t after = timestamp();
+    ++m_stats.sampled;
+    m_stats.sampled_callback_cycles +=
+      std::max(after - before, rdtsc_overhead()) - rdtsc_overhead();
+    const std::uint64_t interval = before - m_last;
+    const int bucket = interval > 0 ? 63 - __builtin_clzll(interval) : 0;
+    ++m_stats.fill_histogram[std::min<std::size_t>(
+      bucket, m_stats.fill_histogram.size() - 1)];
+    m_last = after;
+  }
+
+private:
+  // rdtsc fenced on both sides, so a timed section is neither started
+  // before the code preceding it has finished nor ends before its own
+  // instructions have
+  static std::uint64_t timestamp()
+  {
+    _mm_lfence();
+    const std::uint64_t t = __rdtsc();
+    _mm_lfence();
+    return t;
+  }
+
+  // times its own lifetime, which covers the return of the encryption
+  class CipherTimer
+  {
+  public:
+    CipherTimer(ForEachStats& stats, std::uint64_t n)
+      : m_stats(stats)
+      , m_n(n)
+      , m_before(timestamp())
+    {}
+    ~CipherTimer()
+    {
+      const std::uint64_t elapsed = timestamp() - m_before;
+      m_stats.sampled_encryptions += m_n;
+      m_stats.sampled_cipher_cycles +=
+        std::max(elapsed, rdtsc_overhead()) - rdtsc_overhead();
+    }
+
+  private:
+    ForEachStats& m_stats;
+    std::uint64_t m_n;
+    std::uint64_t m_before;
+  };
+
+  // cycles measured between two back to back timestamps, which is
+  // subtracted from the cipher and callback timings
+  static std::uint64_t rdtsc_overhead()
+  {
+    static const std::uint64_t overhead = []() {
+      std::uint64_t best = ~std::uint64_t{ 0 };
+      for (int i = 0; i < 64; ++i) {
+        const std::uint64_t before = timestamp();
+        const std::uint64_t after = timestamp();
+        best = std::min(best, after - before);
+      }
+      return best;
+    }();
+    return overhead;
+  }
+
+  ForEachStats m_stats;
+  std::uint64_t m_countdown = ForEachStats::SampleInterval;
+  std::uint64_t m_cipher_countdown = ForEachStats::SampleInterval;
+  std::uint64_t m_start;
+  std::uint64_t m_last;
+};
+
+using DefaultStatsRecorder = StatsRecorder<RANDOM_FOREACH_STATS != 0>;
@@ -41,48 +41,53 @@ public:
     static_assert(Derived::ROUNDS >= 0, "ROUNDS must be 0 or larger");
     return Derived::ROUNDS;
   }
-  EncryptTypeFull encrypt(const EncryptTypeFull& cleartext)
+  /// the block size in bits
+  constexpr int bits() const { return 2 * m_Nbitshalf; }
+  constexpr EncryptTypeFull encrypt(const EncryptTypeFull& cleartext)
   {
     return commonEncryptAndDecrypt<Encrypt>(cleartext);
   }
-  EncryptTypeFull decrypt(const EncryptTypeFull& ciphertext)
+  constexpr EncryptTypeFull decrypt(const EncryptTypeFull& ciphertext)
   {
     return commonEncryptAndDecrypt<Decrypt>(ciphertext);
   }
 
+  // constexpr if the round function and constructor of Derived are. the
+  // halves are swapped by hand, std::swap is not constexpr before c++20.
   template<Direction direction>
-  EncryptTypeFull commonEncryptAndDecrypt(const EncryptTypeFull& input)
+  constexpr EncryptTypeFull commonEncryptAndDecrypt(
+    const EncryptTypeFull& input)
   {
     if constexpr (rounds() == 0)
       return input;
     EncryptTypeHalf left = (input >> m_Nbitshalf) & m_mask;
     EncryptTypeHalf right = input & m_mask;
-    int round;
     for (int i = 0; i < rounds(); ++i) {
-      if constexpr (direction == Encrypt)
-        round = i;
-      else
-        round = rounds() - 1 - i;
+      const int round = direction == Encrypt ? i : rounds() - 1 - i;
       EncryptTypeHalf Fresult = This()->roundFunction(right, round);
       left ^= Fresult;
       left &= m_mask;
-      std::swap(left, right);
+      const EncryptTypeHalf tmp = left;
+      left = right;
+      right = tmp;
     }
-    std::swap(left, right);
-    return (EncryptTypeFull{ left } << m_Nbitshalf) | right;
+    return (EncryptTypeFull{ right } << m_Nbitshalf) | left;
   }
 
 protected:
   const int m_Nbitshalf;
   const EncryptTypeHalf m_mask;
-  explicit GenericFeistel(int Nbits)
-    : m_mask((1ULL << (Nbits / 2)) - 1)
-    , m_Nbitshalf(Nbits / 2)
+  constexpr explicit GenericFeistel(int Nbits)
+    : m_Nbitshalf(Nbits / 2)
+    , m_mask(Nbits / 2 >= 64 ? ~0ULL : (1ULL << (Nbits / 2)) - 1)
   {
     assert(Nbits <= 8 * sizeof(EncryptTypeFull));
   }
 
 private:
-  Derived* This() { return static_cast<Derived*>(this); }
-  const Derived* This() const { return static_cast<const Derived*>(this); }
+  constexpr Derived* This() { return static_cast<Derived*>(this); }
+  constexpr const Derived* This() const
+  {
+    return static_cast<const Derived*>(this);
+  }
 };
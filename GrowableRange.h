@@ -0,0 +1,180 @@
+/*
+ * By Paul Dreik 2019,2020
+ * https://www.pauldreik.se/
+ * License: Boost 1.0
+ * SPDX-License-Identifier: BSL-1.0
+ */
+#pragma once
+
+#include <cassert>
+#include <cstdint>
+#include <random>
+#include <vector>
+
+#include "CryptoForEach.h"
+#include "Fnv1aCiphers.h"
+
+/**
+ * @brief The GrowableRange class
+ * Visits [0,M) in random order exactly once, like crypto_for_each, but M
+ * may be increased while the run is going. What has been visited so far
+ * is not repeated, and growing costs work proportional to the new part
+ * only.
+ *
+ * The range is split in layers, each with its own cipher over a part of
+ * the range. Growing extends the top layer as far as its cipher domain
+ * (rounded up to an even number of bits) reaches, and puts the rest in a
+ * new layer. The top layer has already passed some counters, so the new
+ * values those counters map to would be missed: they are instead visited
+ * by a backfill layer over the extension, which only accepts values whose
+ * counter in the top layer was passed at the time of growing. Each value
+ * is thus owned by exactly one layer.
+ *
+ * The next layer to draw from is picked with a probability proportional
+ * to the number of values it has left, so the layers are mixed evenly.
+ *
+ * Crypto must have encrypt and decrypt, Dynamic64 handles M up to 2^62.
+ */
+template<typename Crypto = Dynamic64>
+class GrowableRange
+{
+public:
+  template<typename URBG>
+  GrowableRange(std::uint64_t M, URBG&& urbg)
+    : m_rng(urbg())
+  {
+    grow(M);
+  }
+
+  /// the current range is [0,size())
+  std::uint64_t size() const { return m_M; }
+
+  /// number of values in [0,size()) not yet visited
+  std::uint64_t remaining() const { return m_remaining; }
+
+  /// extends the range to [0,newM), newM must not be less than size()
+  void grow(std::uint64_t newM)
+  {
+    assert(newM >= m_M);
+    assert(newM <= (std::uint64_t{ 1 } << 62));
+    if (newM == m_M) {
+      return;
+    }
+    const std::uint64_t oldM = m_M;
+    std::uint64_t next = oldM;
+    if (!m_layers.empty()) {
+      // the top layer is the one with the highest range, it is always the
+      // last plain layer added
+      const std::size_t top = m_top;
+      Layer& t = m_layers[top];
+      const std::uint64_t reach = t.lo + t.domain();
+      if (reach > oldM) {
+        const std::uint64_t hi = std::min(reach, newM);
+        // values in [oldM,hi) that map to counters already passed
+        std::uint64_t backfilled = 0;
+        for (std::uint64_t v = oldM; v < hi; ++v) {
+          backfilled += t.cipher.decrypt(v - t.lo) < t.counter;
+        }
+        t.hi = hi;
+        t.remaining += (hi - oldM) - backfilled;
+        if (backfilled > 0) {
+          Layer b = make_layer(oldM, hi);
+          b.owner = static_cast<int>(top);
+          b.threshold = m_layers[top].counter;
+          b.remaining = backfilled;
+          m_layers.push_back(std::move(b));
+        }
+        next = hi;
+      }
+    }
+    if (next < newM) {
+      m_layers.push_back(make_layer(next, newM));
+      m_top = m_layers.size() - 1;
+    }
+    m_remaining += newM - oldM;
+    m_M = newM;
+  }
+
+  /// gets the next value, returns false when all of [0,size()) is visited
+  bool next(std::uint64_t& value)
+  {
+    if (m_remaining == 0) {
+      return false;
+    }
+    // pick a layer weighted by the number of values it has left
+    std::uint64_t pick =
+      std::uniform_int_distribution<std::uint64_t>(0, m_remaining - 1)(m_rng);
+    std::size_t i = 0;
+    while (pick >= m_layers[i].remaining) {
+      pick -= m_layers[i].remaining;
+      ++i;
+    }
+    Layer& layer = m_layers[i];
+    for (;;) {
+      const std::uint64_t counter = layer.counter++;
+      const std::uint64_t v = layer.lo + layer.cipher.encrypt(counter);
+      if (v < layer.hi && accepts(layer, v)) {
+        --layer.remaining;
+        --m_remaining;
+        value = v;
+        return true;
+      }
+    }
+  }
+
+  /// visits all remaining values
+  template<typename Callback>
+  void for_each(Callback&& cb)
+  {
+    DefaultStatsRecorder stats;
+    std::uint64_t value;
+    while (next(value)) {
+      stats.deliver(cb, value);
+    }
+  }
+
+  /// number of layers created so far, for diagnostics
+  std::size_t layers() const { return m_layers.size(); }
+
+private:
+  struct Layer
+  {
+    // the layer covers values [lo,hi), as lo + encrypt(counter)
+    std::uint64_t lo;
+    std::uint64_t hi;
+    int bits;
+    Crypto cipher;
+    std::uint64_t counter = 0;
+    std::uint64_t remaining = 0;
+    // for backfill layers: accept only values v for which the owner
+    // layer's counter is below threshold
+    int owner = -1;
+    std::uint64_t threshold = 0;
+
+    std::uint64_t domain() const { return std::uint64_t{ 1 } << bits; }
+  };
+
+  Layer make_layer(std::uint64_t lo, std::uint64_t hi)
+  {
+    const int bits = even_bits_needed(hi - lo);
+    Layer layer{ lo, hi, bits, Crypto(bits) };
+    layer.cipher.seed(m_rng);
+    layer.remaining = hi - lo;
+    return layer;
+  }
+
+  bool accepts(const Layer& layer, std::uint64_t v)
+  {
+    if (layer.owner < 0) {
+      return true;
+    }
+    Layer& owner = m_layers[static_cast<std::size_t>(layer.owner)];
+    return owner.cipher.decrypt(v - owner.lo) < layer.threshold;
+  }
+
+  std::mt19937_64 m_rng;
+  std::vector<Layer> m_layers;
+  std::size_t m_top = 0;
+  std::uint64_t m_M = 0;
+  std::uint64_t m_remaining = 0;
+};
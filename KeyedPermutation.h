@@ -0,0 +1,81 @@
+#pragma once
+/*
+ * By Paul Dreik 2019,2020
+ * https://www.pauldreik.se/
+ * License: Boost 1.0
+ * SPDX-License-Identifier: BSL-1.0
+ */
+#include <cstdint>
+
+#include "CryptoForEach.h"
+#include "Feistel128.h"
+
+/**
+ * @brief The CycleWalkingPermutation class
+ * A random access permutation of [0,M). The cipher works on [0,2^bits)
+ * which is larger than M, so the encryption is repeated until the result
+ * lands in [0,M) ("cycle walking"). Following the cycles of a permutation
+ * restricted to a subset gives a permutation of that subset.
+ *
+ * Contrary to crypto_for_each, the value at position i can be found without
+ * visiting the positions before it, which is what makes it possible to split
+ * the work between threads or to look up single positions.
+ * The domain is less than 4M, so the expected number of encryptions per
+ * value is less than four.
+ *
+ * Crypto is any of the feistel ciphers with a decrypt function, but the
+ * order is only as good as the cycle structure of the cipher. The two round
+ * Dynamic32 and Dynamic64 have every cycle of length four, so walking them
+ * leaves about a quarter of the positions in place unless the domain is
+ * exactly 4^k. Use ShufflePermutation below.
+ */
+template<typename Crypto, typename Integer = std::uint64_t>
+class CycleWalkingPermutation
+{
+public:
+  explicit CycleWalkingPermutation(Integer M)
+    : m_cipher(even_bits_needed(M))
+    , m_M(M)
+  {}
+
+  template<typename URBG>
+  void seed(URBG&& urbg)
+  {
+    m_cipher.seed(urbg);
+  }
+
+  Integer size() const { return m_M; }
+
+  // the value at position i, i must be in [0,M)
+  Integer operator()(Integer i) { return value_at(i); }
+
+  Integer value_at(Integer i)
+  {
+    Integer x = m_cipher.encrypt(i);
+    while (x >= m_M) {
+      x = m_cipher.encrypt(x);
+    }
+    return x;
+  }
+
+  // the position of value x, x must be in [0,M)
+  Integer inverse(Integer x)
+  {
+    Integer i = m_cipher.decrypt(x);
+    while (i >= m_M) {
+      i = m_cipher.decrypt(i);
+    }
+    return i;
+  }
+
+private:
+  Crypto m_cipher;
+  Integer m_M;
+};
+
+/**
+ * the cycle walking permutation to shuffle with. Four rounds with distinct
+ * keys have no structure in the cycles that shows up as fixed points or
+ * skewed displacements, see cyclewalk_test.cpp.
+ */
+using ShufflePermutation = CycleWalkingPermutation<Aes128Feistel<4>>;
@@ -0,0 +1,194 @@
+#pragma once
+/*
+ * By Paul Dreik 2019,2020
+ * https://www.pauldreik.se/
+ * License: Boost 1.0
+ * SPDX-License-Identifier: BSL-1.0
+ */
+#include <immintrin.h>
+#include <array>
+#include <cassert>
+#include <cstdint>
+#include <type_traits>
+
+/**
+ * @brief The ManyU class
+ * Lanes unsigned integers of type T in an avx2 register. T may be 16, 32
+ * or 64 bits wide, giving 16, 8 or 4 lanes.
+ *
+ * Arithmetic wraps like for the scalar type. avx2 lacks a 64 bit
+ * multiplication, so that one is put together from 32 bit ones.
+ */
+template<typename T, int Lanes = static_cast<int>(32 / sizeof(T))>
+struct ManyU
+{
+  static_assert(std::is_unsigned_v<T>, "lanes must be unsigned");
+  static_assert(sizeof(T) == 2 || sizeof(T) == 4 || sizeof(T) == 8,
+                "lanes must be 16, 32 or 64 bits");
+  static_assert(Lanes * sizeof(T) == sizeof(__m256i),
+                "the lanes must fill the register");
+
+  using Int = T;
+  static constexpr int size() { return Lanes; }
+
+  // sets all elements to the same value x
+  explicit ManyU(Int x) noexcept
+  {
+    if constexpr (sizeof(Int) == 2) {
+      m_x = _mm256_set1_epi16(static_cast<short>(x));
+    } else if constexpr (sizeof(Int) == 4) {
+      m_x = _mm256_set1_epi32(static_cast<int>(x));
+    } else {
+      m_x = _mm256_set1_epi64x(static_cast<long long>(x));
+    }
+  }
+
+  // one value per lane, the last argument goes into lane 0 like
+  // for _mm256_set_epi32
+  template<typename... Ints,
+           typename = std::enable_if_t<sizeof...(Ints) == Lanes>>
+  ManyU(Ints... x) noexcept
+  {
+    const Int tmp[Lanes] = { static_cast<Int>(x)... };
+    Int reversed[Lanes];
+    for (int i = 0; i < Lanes; ++i) {
+      reversed[i] = tmp[Lanes - 1 - i];
+    }
+    m_x = _mm256_loadu_si256((const __m256i*)reversed);
+  }
+  explicit ManyU(__m256i x) noexcept
+    : m_x(x)
+  {}
+
+  // lane i holds i
+  static ManyU iota() noexcept
+  {
+    Int tmp[Lanes];
+    for (int i = 0; i < Lanes; ++i) {
+      tmp[i] = static_cast<Int>(i);
+    }
+    return ManyU{ _mm256_loadu_si256((const __m256i*)tmp) };
+  }
+
+  ManyU& operator^=(const ManyU& other) noexcept
+  {
+    m_x = _mm256_xor_si256(m_x, other.m_x);
+    return *this;
+  }
+  ManyU& operator&=(const ManyU& other) noexcept
+  {
+    m_x = _mm256_and_si256(m_x, other.m_x);
+    return *this;
+  }
+  ManyU& operator*=(const ManyU& other) noexcept
+  {
+    if constexpr (sizeof(Int) == 2) {
+      m_x = _mm256_mullo_epi16(m_x, other.m_x);
+    } else if constexpr (sizeof(Int) == 4) {
+      m_x = _mm256_mullo_epi32(m_x, other.m_x);
+    } else {
+      const __m256i a = m_x;
+      const __m256i b = other.m_x;
+      const __m256i lo = _mm256_mul_epu32(a, b);
+      const __m256i t1 = _mm256_mul_epu32(_mm256_srli_epi64(a, 32), b);
+      const __m256i t2 = _mm256_mul_epu32(a, _mm256_srli_epi64(b, 32));
+      m_x = _mm256_add_epi64(
+        lo, _mm256_slli_epi64(_mm256_add_epi64(t1, t2), 32));
+    }
+    return *this;
+  }
+  ManyU& operator+=(const ManyU& other) noexcept
+  {
+    if constexpr (sizeof(Int) == 2) {
+      m_x = _mm256_add_epi16(m_x, other.m_x);
+    } else if constexpr (sizeof(Int) == 4) {
+      m_x = _mm256_add_epi32(m_x, other.m_x);
+    } else {
+      m_x = _mm256_add_epi64(m_x, other.m_x);
+    }
+    return *this;
+  }
+  // avoid accidental use of if(obj), since
+  // it is unclear if it means "any" or "all"
+  // for a vector.
+  operator bool() const = delete;
+
+  template<int i>
+  Int get() const noexcept
+  {
+    static_assert(i >= 0 && i < Lanes, "outside bounds");
+    Int tmp[Lanes];
+    static_assert(sizeof(*this) == sizeof(tmp), "");
+    _mm256_storeu_si256((__m256i*)&tmp[0], m_x);
+    return tmp[i];
+  }
+  std::array<Int, Lanes> toArray() const
+  {
+    std::array<Int, Lanes> ret;
+    _mm256_storeu_si256((__m256i*)&ret[0], m_x);
+    return ret;
+  }
+  __m256i m_x;
+};
+
+using ManyU16 = ManyU<std::uint16_t>;
+using ManyU64 = ManyU<std::uint64_t>;
+
+template<typename T, int Lanes>
+inline ManyU<T, Lanes>
+operator^(const ManyU<T, Lanes>& a, const ManyU<T, Lanes>& b) noexcept
+{
+  return ManyU<T, Lanes>{ _mm256_xor_si256(a.m_x, b.m_x) };
+}
+template<typename T, int Lanes>
+inline ManyU<T, Lanes>
+operator&(const ManyU<T, Lanes>& a, const ManyU<T, Lanes>& b) noexcept
+{
+  return ManyU<T, Lanes>{ _mm256_and_si256(a.m_x, b.m_x) };
+}
+template<typename T, int Lanes>
+inline ManyU<T, Lanes>
+operator|(const ManyU<T, Lanes>& a, const ManyU<T, Lanes>& b) noexcept
+{
+  return ManyU<T, Lanes>{ _mm256_or_si256(a.m_x, b.m_x) };
+}
+template<typename T, int Lanes>
+inline ManyU<T, Lanes>
+operator>>(const ManyU<T, Lanes>& a, int n) noexcept
+{
+  assert(n >= 0);
+  assert(n < static_cast<int>(8 * sizeof(T)));
+  if constexpr (sizeof(T) == 2) {
+    return ManyU<T, Lanes>{ _mm256_srli_epi16(a.m_x, n) };
+  } else if constexpr (sizeof(T) == 4) {
+    return ManyU<T, Lanes>{ _mm256_srli_epi32(a.m_x, n) };
+  } else {
+    return ManyU<T, Lanes>{ _mm256_srli_epi64(a.m_x, n) };
+  }
+}
+template<typename T, int Lanes>
+inline ManyU<T, Lanes>
+operator<<(const ManyU<T, Lanes>& a, int n) noexcept
+{
+  assert(n >= 0);
+  assert(n < static_cast<int>(8 * sizeof(T)));
+  if constexpr (sizeof(T) == 2) {
+    return ManyU<T, Lanes>{ _mm256_slli_epi16(a.m_x, n) };
+  } else if constexpr (sizeof(T) == 4) {
+    return ManyU<T, Lanes>{ _mm256_slli_epi32(a.m_x, n) };
+  } else {
+    return ManyU<T, Lanes>{ _mm256_slli_epi64(a.m_x, n) };
+  }
+}
+template<typename T, int Lanes>
+inline ManyU<T, Lanes>
+operator==(const ManyU<T, Lanes>& a, const ManyU<T, Lanes>& b) noexcept
+{
+  if constexpr (sizeof(T) == 2) {
+    return ManyU<T, Lanes>{ _mm256_cmpeq_epi16(a.m_x, b.m_x) };
+  } else if constexpr (sizeof(T) == 4) {
+    return ManyU<T, Lanes>{ _mm256_cmpeq_epi32(a.m_x, b.m_x) };
+  } else {
+    return ManyU<T, Lanes>{ _mm256_cmpeq_epi64(a.m_x, b.m_x) };
+  }
+}
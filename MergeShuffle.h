@@ -0,0 +1,250 @@
+/*
+ * By Paul Dreik 2019,2020
+ * https://www.pauldreik.se/
+ * License: Boost 1.0
+ * SPDX-License-Identifier: BSL-1.0
+ */
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "CounterRng.h"
+#include "MurmurCryptFixed64.h"
+
+namespace MergeShuffleInternals {
+
+// blocks of at most this many elements are shuffled with Fisher-Yates,
+// small enough to stay in cache
+constexpr std::size_t BlockSize = std::size_t{ 1 } << 16;
+
+using Rng = CounterRng<MurmurCryptFixed64>;
+
+/**
+ * hands out single random bits, and integers in a range using as few
+ * draws from the generator as it can
+ */
+class RandomBits
+{
+public:
+  explicit RandomBits(const Rng& rng)
+    : m_rng(rng)
+  {}
+
+  bool flip()
+  {
+    if (m_left == 0) {
+      m_bits = m_rng();
+      m_left = 64;
+    }
+    const bool ret = m_bits & 1U;
+    m_bits >>= 1;
+    --m_left;
+    return ret;
+  }
+
+  /**
+   * uniform in [0,n), with the multiply and reject method of Lemire,
+   * https://arxiv.org/abs/1805.10941 . Each 64 bit draw gives two 32 bit
+   * halves.
+   */
+  std::uint32_t below(std::uint32_t n)
+  {
+    std::uint64_t m = std::uint64_t{ half() } * n;
+    auto low = static_cast<std::uint32_t>(m);
+    if (low < n) {
+      const std::uint32_t threshold = -n % n;
+      while (low < threshold) {
+        m = std::uint64_t{ half() } * n;
+        low = static_cast<std::uint32_t>(m);
+      }
+    }
+    return static_cast<std::uint32_t>(m >> 32);
+  }
+
+  /// uniform in [0,n)
+  std::uint64_t below(std::uint64_t n)
+  {
+    if (n < (std::uint64_t{ 1 } << 32)) {
+      return below(static_cast<std::uint32_t>(n));
+    }
+    if (n == (std::uint64_t{ 1 } << 32)) {
+      return half();
+    }
+    unsigned __int128 m = static_cast<unsigned __int128>(m_rng()) * n;
+    auto low = static_cast<std::uint64_t>(m);
+    if (low < n) {
+      const std::uint64_t threshold = -n % n;
+      while (low < threshold) {
+        m = static_cast<unsigned __int128>(m_rng()) * n;
+        low = static_cast<std::uint64_t>(m);
+      }
+    }
+    return static_cast<std::uint64_t>(m >> 64);
+  }
+
+private:
+  std::uint32_t half()
+  {
+    if (m_halves == 0) {
+      m_word = m_rng();
+      m_halves = 2;
+    }
+    --m_halves;
+    const auto ret = static_cast<std::uint32_t>(m_word);
+    m_word >>= 32;
+    return ret;
+  }
+
+  Rng m_rng;
+  std::uint64_t m_bits = 0;
+  int m_left = 0;
+  std::uint64_t m_word = 0;
+  int m_halves = 0;
+};
+
+template<typename RandomIt>
+void
+fisher_yates(RandomIt first, RandomIt last, RandomBits& bits)
+{
+  using std::swap;
+  const auto n = static_cast<std::uint64_t>(last - first);
+  for (std::uint64_t i = n; i > 1; --i) {
+    swap(first[i - 1], first[bits.below(i)]);
+  }
+}
+
+/**
+ * merges the shuffled [first,mid) and [mid,last) into a shuffled
+ * [first,last). This is the merge of MergeShuffle, see Bacher, Bodini,
+ * Hollender and Lumbroso, "MergeShuffle: A Very Fast, Parallel Random
+ * Permutation Algorithm", https://arxiv.org/abs/1508.03167 . One coin flip
+ * per element picks which half the next one is taken from. When one half
+ * runs out, the rest are inserted at random positions like in
+ * Fisher-Yates, which is a small part of the work.
+ */
+template<typename RandomIt>
+void
+merge(RandomIt first, RandomIt mid, RandomIt last, RandomBits& bits)
+{
+  using std::swap;
+  RandomIt u = first;
+  RandomIt v = mid;
+  using Value = typename std::iterator_traits<RandomIt>::value_type;
+  if constexpr (std::is_trivially_copyable_v<Value>) {
+    // the coin flips are not predictable, so avoid branching on them while
+    // neither half can run out. not taking from the second half is done as
+    // swapping *u with itself.
+    while (u < v && v < last) {
+      const bool second = bits.flip();
+      swap(*u, *(second ? v : u));
+      v += second;
+      ++u;
+    }
+  }
+  for (;;) {
+    if (bits.flip()) {
+      if (v == last) {
+        break;
+      }
+      swap(*u, *v++);
+    } else if (u == v) {
+      break;
+    }
+    ++u;
+  }
+  for (; u != last; ++u) {
+    const auto i = static_cast<std::uint64_t>(u - first);
+    swap(first[bits.below(i + 1)], *u);
+  }
+}
+
+/// runs task(0)...task(count-1) on up to nthreads threads
+template<typename Task>
+void
+parallel_for(std::size_t count, unsigned nthreads, Task&& task)
+{
+  const auto n = static_cast<unsigned>(std::min<std::size_t>(nthreads, count));
+  if (n <= 1) {
+    for (std::size_t i = 0; i < count; ++i) {
+      task(i);
+    }
+    return;
+  }
+  std::atomic<std::size_t> next{ 0 };
+  auto worker = [&]() {
+    for (std::size_t i; (i = next++) < count;) {
+      task(i);
+    }
+  };
+  std::vector<std::thread> threads;
+  for (unsigned t = 1; t < n; ++t) {
+    threads.emplace_back(worker);
+  }
+  worker();
+  for (auto& t : threads) {
+    t.join();
+  }
+}
+}
+
+/**
+ * shuffles [first,last) uniformly at random, like std::shuffle, using
+ * MergeShuffle: the range is cut in blocks which are shuffled
+ * independently, and then merged pairwise until one remains. Both steps
+ * run in parallel. It uses about n*log2(n/BlockSize) random bits for the
+ * merges, on top of Fisher-Yates for the blocks.
+ *
+ * Unlike the cipher based orders, every permutation is equally likely
+ * (given a perfect random generator). The blocks and merges each draw from
+ * their own stream of a CounterRng keyed by seed, so the result depends
+ * only on the seed, not on the number of threads. nthreads=0 means use all
+ * cores.
+ *
+ * The last merge is a single pass over the whole range and does not run
+ * in parallel.
+ */
+template<typename RandomIt>
+void
+merge_shuffle(RandomIt first,
+              RandomIt last,
+              std::uint64_t seed,
+              unsigned nthreads = 0)
+{
+  using namespace MergeShuffleInternals;
+  if (nthreads == 0) {
+    nthreads = std::max(1U, std::thread::hardware_concurrency());
+  }
+  const auto n = static_cast<std::size_t>(last - first);
+  // a power of two number of blocks, so the merges form a complete binary
+  // tree. nodes are numbered as in a heap, root 1 and leaves from blocks.
+  std::size_t blocks = 1;
+  while (n / blocks > BlockSize) {
+    blocks *= 2;
+  }
+  // each node needs a stream of its own
+  assert(2 * blocks <= (std::uint64_t{ 1 } << (64 - Rng::StreamBits)));
+  const Rng rng(seed);
+  auto bound = [&](std::size_t b) { return first + n * b / blocks; };
+
+  parallel_for(blocks, nthreads, [&](std::size_t b) {
+    RandomBits bits(rng.split(blocks + b));
+    fisher_yates(bound(b), bound(b + 1), bits);
+  });
+  for (std::size_t width = 1; width < blocks; width *= 2) {
+    const std::size_t merges = blocks / (2 * width);
+    parallel_for(merges, nthreads, [&](std::size_t k) {
+      RandomBits bits(rng.split(merges + k));
+      const std::size_t b = 2 * width * k;
+      merge(bound(b), bound(b + width), bound(b + 2 * width), bits);
+    });
+  }
+}
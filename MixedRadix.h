@@ -0,0 +1,254 @@
+#pragma once
+/*
+ * By Paul Dreik 2019,2020
+ * https://www.pauldreik.se/
+ * License: Boost 1.0
+ * SPDX-License-Identifier: BSL-1.0
+ */
+#include <algorithm>
+#include <array>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <utility>
+
+#include <immintrin.h>
+
+#include "CryptoForEach.h"
+#include "ManyU32.h"
+#include "simdfeistel.h"
+
+/**
+ * division by an invariant integer, replaced by a multiplication and shifts.
+ * See Granlund and Montgomery, "Division by Invariant Integers using
+ * Multiplication", figure 4.1. Exact for all 64 bit numerators and divisors.
+ */
+class FastDivider64
+{
+public:
+  explicit FastDivider64(std::uint64_t d = 1)
+  {
+    assert(d > 0);
+    const int l = bits_needed(d);
+    const unsigned __int128 excess = (static_cast<unsigned __int128>(1) << l) - d;
+    m_magic = static_cast<std::uint64_t>((excess << 64) / d + 1);
+    m_shift1 = l > 0 ? 1 : 0;
+    m_shift2 = l > 0 ? l - 1 : 0;
+  }
+  std::uint64_t divide(std::uint64_t n) const
+  {
+    const auto t =
+      static_cast<std::uint64_t>((static_cast<unsigned __int128>(m_magic) * n) >> 64);
+    return (t + ((n - t) >> m_shift1)) >> m_shift2;
+  }
+
+private:
+  std::uint64_t m_magic;
+  int m_shift1;
+  int m_shift2;
+};
+
+/**
+ * 32 bit version of FastDivider64, dividing eight lanes at a time.
+ */
+class FastDivider32
+{
+public:
+  explicit FastDivider32(std::uint32_t d = 1)
+  {
+    assert(d > 0);
+    const int l = bits_needed(d);
+    const std::uint64_t excess = (std::uint64_t{ 1 } << l) - d;
+    const auto magic = static_cast<std::uint32_t>((excess << 32) / d + 1);
+    m_magic = _mm256_set1_epi32(static_cast<int>(magic));
+    m_shift1 = _mm_cvtsi32_si128(l > 0 ? 1 : 0);
+    m_shift2 = _mm_cvtsi32_si128(l > 0 ? l - 1 : 0);
+  }
+  ManyU32 divide(ManyU32 n) const
+  {
+    // high half of the 32x32 bit products, even and odd lanes separately
+    const __m256i even = _mm256_srli_epi64(_mm256_mul_epu32(n.m_x, m_magic), 32);
+    const __m256i odd = _mm256_mul_epu32(_mm256_srli_epi64(n.m_x, 32), m_magic);
+    const __m256i t = _mm256_blend_epi32(even, odd, 0xAA);
+    const __m256i q = _mm256_add_epi32(
+      t, _mm256_srl_epi32(_mm256_sub_epi32(n.m_x, t), m_shift1));
+    return ManyU32{ _mm256_srl_epi32(q, m_shift2) };
+  }
+
+private:
+  __m256i m_magic;
+  __m128i m_shift1;
+  __m128i m_shift2;
+};
+
+namespace MixedRadixInternals {
+// ManyU32 is not default constructible, so arrays of it need a value
+template<std::size_t... I>
+std::array<ManyU32, sizeof...(I)>
+filled(ManyU32 x, std::index_sequence<I...>)
+{
+  return { { ((void)I, x)... } };
+}
+}
+
+/**
+ * @brief The MixedRadixSpace class
+ * The cartesian product [0,r_0) x [0,r_1) x ... x [0,r_{Dims-1}), with each
+ * tuple numbered by an index in [0,size()) where the first component varies
+ * fastest. This makes it possible to visit a product space in random order
+ * by running any of the drivers on the index.
+ *
+ * Decoding an index uses a precomputed reciprocal per radix instead of
+ * hardware division, which would otherwise cost more than the cipher.
+ */
+template<std::size_t Dims>
+class MixedRadixSpace
+{
+public:
+  static_assert(Dims > 0, "need at least one dimension");
+  using Tuple = std::array<std::uint64_t, Dims>;
+
+  explicit MixedRadixSpace(const Tuple& radices)
+    : m_radices(radices)
+  {
+    m_size = 1;
+    for (std::size_t d = 0; d < Dims; ++d) {
+      assert(radices[d] > 0);
+      if (__builtin_mul_overflow(m_size, radices[d], &m_size)) {
+        std::puts("the product of the radices does not fit in 64 bits");
+        std::abort();
+      }
+      m_dividers[d] = FastDivider64(radices[d]);
+    }
+  }
+
+  std::uint64_t size() const { return m_size; }
+  const Tuple& radices() const { return m_radices; }
+
+  Tuple decode(std::uint64_t index) const
+  {
+    Tuple ret;
+    for (std::size_t d = 0; d + 1 < Dims; ++d) {
+      const std::uint64_t q = m_dividers[d].divide(index);
+      ret[d] = index - q * m_radices[d];
+      index = q;
+    }
+    ret[Dims - 1] = index;
+    return ret;
+  }
+
+  std::uint64_t encode(const Tuple& t) const
+  {
+    std::uint64_t index = t[Dims - 1];
+    for (std::size_t d = Dims - 1; d-- > 0;) {
+      index = index * m_radices[d] + t[d];
+    }
+    return index;
+  }
+
+private:
+  Tuple m_radices;
+  std::array<FastDivider64, Dims> m_dividers;
+  std::uint64_t m_size;
+};
+
+/**
+ * invokes cb once with each tuple in the space, in random order.
+ * Crypto must handle the number of bits needed for space.size(),
+ * for instance Dynamic64.
+ */
+template<typename Crypto,
+         std::size_t Dims,
+         typename URBG,
+         typename Callback>
+void
+mixed_radix_for_each(const MixedRadixSpace<Dims>& space,
+                     URBG&& rng,
+                     Callback&& cb)
+{
+  crypto_for_each<Crypto>(
+    space.size(), rng, [&](std::uint64_t index) { cb(space.decode(index)); });
+}
+
+/**
+ * simd version of mixed_radix_for_each, for spaces of at most 2^32 tuples.
+ * cb is invoked with one vector per component, holding eight tuples, and a
+ * mask telling which lanes are valid (bit i set means lane i of
+ * toArray() is valid).
+ * Each tuple is delivered exactly once.
+ */
+template<std::size_t Dims, typename URBG, typename Callback>
+void
+mixed_radix_simd_for_each(const MixedRadixSpace<Dims>& space,
+                          URBG&& rng,
+                          Callback&& cb)
+{
+  const std::uint64_t M = space.size();
+  if (M > (std::uint64_t{ 1 } << 32)) {
+    std::puts("implement switching to 64 bit");
+    std::abort();
+  }
+  std::array<FastDivider32, Dims> dividers;
+  auto radices =
+    MixedRadixInternals::filled(ManyU32{ 0U }, std::make_index_sequence<Dims>{});
+  // a radix of 2^32 does not fit in a lane. it takes the whole index, which
+  // is only possible when the other radices are one.
+  std::array<bool, Dims> whole{};
+  for (std::size_t d = 0; d < Dims; ++d) {
+    if (space.radices()[d] == M && M == (std::uint64_t{ 1 } << 32)) {
+      whole[d] = true;
+      continue;
+    }
+    const auto r = static_cast<std::uint32_t>(space.radices()[d]);
+    dividers[d] = FastDivider32(r);
+    radices[d] = ManyU32{ r };
+  }
+
+  // the halves must have at least one bit
+  const int bits = std::max(2, even_bits_needed(M));
+  ParallelFeistel cipher(bits);
+  cipher.seed(rng);
+  // with two bits there are only four counters, the other lanes are not
+  const unsigned lanemask = bits == 2 ? 0x0F : 0xFF;
+
+  // unsigned comparison through signed, by flipping the sign bit
+  const __m256i flip = _mm256_set1_epi32(static_cast<int>(0x80000000U));
+  const __m256i limit = _mm256_xor_si256(
+    _mm256_set1_epi32(static_cast<int>(static_cast<std::uint32_t>(M))), flip);
+  const bool everything = M == (std::uint64_t{ 1 } << 32);
+
+  auto components =
+    MixedRadixInternals::filled(ManyU32{ 0U }, std::make_index_sequence<Dims>{});
+  ManyU32 II(0, 1, 2, 3, 4, 5, 6, 7);
+  const ManyU32 lanes(8);
+  for (std::uint64_t count = 0; count < M; II += lanes) {
+    ManyU32 index = cipher.encrypt(II);
+    unsigned mask = lanemask;
+    if (!everything) {
+      const __m256i inrange =
+        _mm256_cmpgt_epi32(limit, _mm256_xor_si256(index.m_x, flip));
+      mask &= static_cast<unsigned>(
+        _mm256_movemask_ps(_mm256_castsi256_ps(inrange)));
+    }
+    if (mask == 0) {
+      continue;
+    }
+    for (std::size_t d = 0; d + 1 < Dims; ++d) {
+      if (whole[d]) {
+        components[d] = index;
+        index = ManyU32{ 0U };
+        continue;
+      }
+      const ManyU32 q = dividers[d].divide(index);
+      ManyU32 qr = q;
+      qr *= radices[d];
+      components[d] = ManyU32{ _mm256_sub_epi32(index.m_x, qr.m_x) };
+      index = q;
+    }
+    components[Dims - 1] = index;
+    cb(components, mask);
+    count += static_cast<unsigned>(__builtin_popcount(mask));
+  }
+}
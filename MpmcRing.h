@@ -0,0 +1,104 @@
+#pragma once
+/*
+ * By Paul Dreik 2019,2020
+ * https://www.pauldreik.se/
+ * License: Boost 1.0
+ * SPDX-License-Identifier: BSL-1.0
+ */
+#include <atomic>
+#include <cassert>
+#include <cstddef>
+#include <memory>
+
+/**
+ * @brief The MpmcRing class
+ * A bounded lock free queue for multiple producers and multiple consumers.
+ * Each slot carries a sequence number telling if it is ready to be written
+ * or read, so a push or pop is a single compare and swap on the head or
+ * tail in the uncontended case.
+ *
+ * see http://www.1024cores.net/home/lock-free-algorithms/queues/bounded-mpmc-queue
+ *
+ * Capacity must be a power of two. T should be cheap to copy, the intended
+ * use is passing small handles (like batch indices) between threads.
+ */
+template<typename T>
+class MpmcRing
+{
+public:
+  explicit MpmcRing(std::size_t capacity)
+    : m_slots(new Slot[capacity])
+    , m_mask(capacity - 1)
+  {
+    assert(capacity >= 2 && (capacity & (capacity - 1)) == 0 &&
+           "capacity must be a power of two");
+    for (std::size_t i = 0; i < capacity; ++i) {
+      m_slots[i].sequence.store(i, std::memory_order_relaxed);
+    }
+    m_head.store(0, std::memory_order_relaxed);
+    m_tail.store(0, std::memory_order_relaxed);
+  }
+
+  // returns false if the queue is full
+  bool try_push(const T& value)
+  {
+    std::size_t pos = m_head.load(std::memory_order_relaxed);
+    for (;;) {
+      Slot& slot = m_slots[pos & m_mask];
+      const std::size_t seq = slot.sequence.load(std::memory_order_acquire);
+      const auto diff =
+        static_cast<std::ptrdiff_t>(seq) - static_cast<std::ptrdiff_t>(pos);
+      if (diff == 0) {
+        if (m_head.compare_exchange_weak(
+              pos, pos + 1, std::memory_order_relaxed)) {
+          slot.value = value;
+          slot.sequence.store(pos + 1, std::memory_order_release);
+          return true;
+        }
+      } else if (diff < 0) {
+        return false;
+      } else {
+        pos = m_head.load(std::memory_order_relaxed);
+      }
+    }
+  }
+
+  // returns false if the queue is empty
+  bool try_pop(T& value)
+  {
+    std::size_t pos = m_tail.load(std::memory_order_relaxed);
+    for (;;) {
+      Slot& slot = m_slots[pos & m_mask];
+      const std::size_t seq = slot.sequence.load(std::memory_order_acquire);
+      const auto diff = static_cast<std::ptrdiff_t>(seq) -
+                        static_cast<std::ptrdiff_t>(pos + 1);
+      if (diff == 0) {
+        if (m_tail.compare_exchange_weak(
+              pos, pos + 1, std::memory_order_relaxed)) {
+          value = slot.value;
+          slot.sequence.store(pos + m_mask + 1, std::memory_order_release);
+          return true;
+        }
+      } else if (diff < 0) {
+        return false;
+      } else {
+        pos = m_tail.load(std::memory_order_relaxed);
+      }
+    }
+  }
+
+  std::size_t capacity() const { return m_mask + 1; }
+
+private:
+  struct Slot
+  {
+    std::atomic<std::size_t> sequence;
+    T value;
+  };
+  std::unique_ptr<Slot[]> m_slots;
+  const std::size_t m_mask;
+  // head and tail on separate cache lines, to avoid false sharing
+  // between producers and consumers
+  alignas(64) std::atomic<std::size_t> m_head;
+  alignas(64) std::atomic<std::size_t> m_tail;
+};
@@ -0,0 +1,124 @@
+/*
+ * By Paul Dreik 2019,2020
+ * https://www.pauldreik.se/
+ * License: Boost 1.0
+ * SPDX-License-Identifier: BSL-1.0
+ */
+#pragma once
+
+#include <array>
+#include <cassert>
+#include <cstdint>
+#include <immintrin.h>
+
+#include "CryptoForEach.h"
+#include "ManyU32.h"
+#include "simdfeistel.h"
+
+/**
+ * @brief The MultiKeyFeistel class
+ * Like ParallelFeistel, but each of the eight lanes has its own key, so
+ * one encryption advances eight independent permutations.
+ *
+ * Lane k seeded with seed_lane(k, urbg) gives the same permutation as a
+ * ParallelFeistel seeded with urbg.
+ */
+class MultiKeyFeistel : public GenericFeistel<MultiKeyFeistel, ManyU32, ManyU32>
+{
+public:
+  static constexpr int ROUNDS = 2;
+  static constexpr int Lanes = 8;
+  using Base = GenericFeistel<MultiKeyFeistel, ManyU32, ManyU32>;
+  explicit MultiKeyFeistel(int Nbits)
+    : Base(Nbits)
+    , m_key{ { ManyU32{ 0U }, ManyU32{ 0U } } }
+  {}
+
+  /// seeds all lanes, lane 0 first
+  template<typename URBG>
+  void seed(URBG&& urbg)
+  {
+    for (int lane = 0; lane < Lanes; ++lane) {
+      seed_lane(lane, urbg);
+    }
+  }
+
+  template<typename URBG>
+  void seed_lane(int lane, URBG&& urbg)
+  {
+    assert(lane >= 0 && lane < Lanes);
+    for (auto& key : m_key) {
+      alignas(32) std::uint32_t tmp[Lanes];
+      _mm256_store_si256((__m256i*)tmp, key.m_x);
+      tmp[lane] = static_cast<std::uint16_t>(urbg());
+      key.m_x = _mm256_load_si256((const __m256i*)tmp);
+    }
+  }
+
+  ManyU32 roundFunction(ManyU32 x, int round) const
+  {
+    return hashfnv1a_16(x) ^ m_key[round];
+  }
+
+private:
+  std::array<ManyU32, ROUNDS> m_key;
+};
+
+/**
+ * visits [0,M) in K independent random orders at once, invoking
+ * cb(k, value) for each value of permutation k in [0,K). K is at most 8
+ * and M at most 2^32. Permutation k gets the keys of lane k, see
+ * MultiKeyFeistel::seed.
+ *
+ * All lanes encrypt the same counter, and the lanes that are finished
+ * are masked off until the slowest one is done.
+ */
+template<typename URBG, typename Callback>
+void
+multikey_for_each(std::uint64_t M, int K, URBG&& rng, Callback&& cb)
+{
+  assert(K >= 1 && K <= MultiKeyFeistel::Lanes);
+  assert(M <= (std::uint64_t{ 1 } << 32));
+  if (M == 0) {
+    return;
+  }
+  MultiKeyFeistel cipher(even_bits_needed(M));
+  cipher.seed(rng);
+  DefaultStatsRecorder stats;
+
+  // unsigned comparison through signed, by flipping the sign bit
+  const __m256i flip = _mm256_set1_epi32(static_cast<int>(0x80000000U));
+  const __m256i limit = _mm256_xor_si256(
+    _mm256_set1_epi32(static_cast<int>(static_cast<std::uint32_t>(M))), flip);
+  const bool everything = M == (std::uint64_t{ 1 } << 32);
+
+  std::array<std::uint64_t, MultiKeyFeistel::Lanes> count{};
+  // lanes still running
+  unsigned active = (1U << K) - 1;
+  for (std::uint32_t i = 0; active != 0; ++i) {
+    const __m256i x =
+      stats.encrypt(static_cast<std::uint64_t>(__builtin_popcount(active)),
+                    [&] { return cipher.encrypt(ManyU32{ i }).m_x; });
+    unsigned mask = active;
+    if (!everything) {
+      const __m256i inrange =
+        _mm256_cmpgt_epi32(limit, _mm256_xor_si256(x, flip));
+      mask &= static_cast<unsigned>(
+        _mm256_movemask_ps(_mm256_castsi256_ps(inrange)));
+    }
+    if (mask == 0) {
+      continue;
+    }
+    alignas(32) std::uint32_t values[MultiKeyFeistel::Lanes];
+    _mm256_store_si256((__m256i*)values, x);
+    while (mask != 0) {
+      const int lane = __builtin_ctz(mask);
+      mask &= mask - 1;
+      auto demux = [&](std::uint32_t value) { cb(lane, value); };
+      stats.deliver(demux, values[lane]);
+      if (++count[lane] == M) {
+        active &= ~(1U << lane);
+      }
+    }
+  }
+}
@@ -9,11 +9,30 @@
  * Encrypts using the same idea as the murmur crypt is based on.
  * Suggest by Martin Ankerl
  * See https://github.com/pauldreik/random_foreach/issues/4
+ *
+ * The key is xored onto the input, and is zero unless seeded.
  */
 class MurmurCryptFixed64
 {
 public:
-  std::uint64_t encrypt_original(std::uint64_t h)
+  template<typename URBG>
+  constexpr void seed(URBG&& urbg)
+  {
+    m_key = urbg();
+    m_key = (m_key << 32) ^ urbg();
+  }
+  constexpr std::uint64_t key() const { return m_key; }
+
+  constexpr bool operator==(const MurmurCryptFixed64& other) const
+  {
+    return m_key == other.m_key;
+  }
+  constexpr bool operator!=(const MurmurCryptFixed64& other) const
+  {
+    return !(*this == other);
+  }
+
+  constexpr std::uint64_t encrypt_original(std::uint64_t h)
   {
     h ^= h >> 33;
     h *= prime1;
@@ -22,8 +41,9 @@ public:
     h ^= h >> 33;
     return h;
   }
-  std::uint64_t encrypt(std::uint64_t h)
+  constexpr std::uint64_t encrypt(std::uint64_t h)
   {
+    h ^= m_key;
     xor_and_shift<33>(h);
     multiply_with_prime<prime1>(h);
     xor_and_shift<33>(h);
@@ -36,6 +56,7 @@ public:
   // for debugging.
   std::uint64_t encrypt_and_debug(std::uint64_t h)
   {
+    h ^= m_key;
     const std::uint64_t h1 = h;
 
     xor_and_shift<33>(h);
@@ -60,19 +81,19 @@ public:
 
     return h;
   }
-  std::uint64_t decrypt(std::uint64_t h)
+  constexpr std::uint64_t decrypt(std::uint64_t h)
   {
     h = undo_xor_and_shift<33>(h);
     h = undo_multiply_with_prime<prime2>(h);
     h = undo_xor_and_shift<33>(h);
     h = undo_multiply_with_prime<prime1>(h);
     h = undo_xor_and_shift<33>(h);
-    return h;
+    return h ^ m_key;
   }
 
   // private:
   template<int shift>
-  void xor_and_shift(std::uint64_t& h)
+  constexpr void xor_and_shift(std::uint64_t& h)
   {
     static_assert(shift >= 32, "shift should be >=32 for this to work");
     static_assert(shift < 64, "shift should be less than 64");
@@ -80,7 +101,7 @@ public:
   }
 
   template<int shift>
-  std::uint64_t undo_xor_and_shift(std::uint64_t h)
+  constexpr std::uint64_t undo_xor_and_shift(std::uint64_t h)
   {
     static_assert(shift >= 32, "shift should be >=32 for this to work");
     static_assert(shift < 64, "shift should be less than 64");
@@ -88,12 +109,12 @@ public:
     return h;
   }
   template<std::uint64_t prime>
-  void multiply_with_prime(std::uint64_t& h)
+  constexpr void multiply_with_prime(std::uint64_t& h)
   {
     h *= prime;
   }
   template<std::uint64_t prime>
-  std::uint64_t undo_multiply_with_prime(std::uint64_t h)
+  constexpr std::uint64_t undo_multiply_with_prime(std::uint64_t h)
   {
     multiply_with_prime<inv_prime(prime)>(h);
     return h;
@@ -183,4 +204,7 @@ public:
 
   static constexpr std::uint64_t prime1 = 0xff51afd7ed558ccd;
   static constexpr std::uint64_t prime2 = 0xc4ceb9fe1a85ec53;
+
+private:
+  std::uint64_t m_key = 0;
 };
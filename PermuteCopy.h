@@ -0,0 +1,146 @@
+#pragma once
+/*
+ * By Paul Dreik 2019,2020
+ * https://www.pauldreik.se/
+ * License: Boost 1.0
+ * SPDX-License-Identifier: BSL-1.0
+ */
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <random>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+#include <immintrin.h>
+
+#include "KeyedPermutation.h"
+
+namespace PermuteCopyInternals {
+
+// number of records handled in one go. the source positions for a block are
+// found first and prefetched, so the reads are in flight when copying.
+constexpr std::size_t BlockSize = 64;
+
+// copies a record to dst without polluting the cache, if the size and
+// alignment allows it
+template<typename Record>
+void
+stream_record(Record* dst, const Record* src)
+{
+  if constexpr (sizeof(Record) % 16 == 0 && alignof(Record) >= 16) {
+    auto d = reinterpret_cast<__m128i*>(dst);
+    auto s = reinterpret_cast<const __m128i*>(src);
+    for (std::size_t i = 0; i < sizeof(Record) / 16; ++i) {
+      _mm_stream_si128(d + i, _mm_loadu_si128(s + i));
+    }
+  } else if constexpr (sizeof(Record) % 8 == 0 && alignof(Record) >= 8) {
+    auto d = reinterpret_cast<long long*>(dst);
+    for (std::size_t i = 0; i < sizeof(Record) / 8; ++i) {
+      long long tmp;
+      std::memcpy(&tmp, reinterpret_cast<const char*>(src) + 8 * i, 8);
+      _mm_stream_si64(d + i, tmp);
+    }
+  } else if constexpr (sizeof(Record) % 4 == 0 && alignof(Record) >= 4) {
+    auto d = reinterpret_cast<int*>(dst);
+    for (std::size_t i = 0; i < sizeof(Record) / 4; ++i) {
+      int tmp;
+      std::memcpy(&tmp, reinterpret_cast<const char*>(src) + 4 * i, 4);
+      _mm_stream_si32(d + i, tmp);
+    }
+  } else {
+    std::memcpy(dst, src, sizeof(Record));
+  }
+}
+
+// gathers dst[i]=src[perm(i)] for i in [begin,end)
+template<typename Record, typename Permutation>
+void
+permute_copy_range(const Record* src,
+                   Record* dst,
+                   Permutation perm,
+                   std::uint64_t begin,
+                   std::uint64_t end)
+{
+  std::uint64_t from[BlockSize];
+  for (std::uint64_t block = begin; block < end; block += BlockSize) {
+    const std::size_t n =
+      static_cast<std::size_t>(std::min<std::uint64_t>(BlockSize, end - block));
+    for (std::size_t j = 0; j < n; ++j) {
+      from[j] = perm(block + j);
+      __builtin_prefetch(src + from[j]);
+    }
+    for (std::size_t j = 0; j < n; ++j) {
+      stream_record(dst + block + j, src + from[j]);
+    }
+  }
+  // make the streaming stores visible before the thread is joined
+  _mm_sfence();
+}
+
+template<typename Record>
+void
+permute_copy_impl(const Record* src,
+                  Record* dst,
+                  std::uint64_t M,
+                  std::uint64_t seed,
+                  unsigned nthreads)
+{
+  ShufflePermutation perm(M);
+  std::mt19937_64 rng(seed);
+  perm.seed(rng);
+
+  // give each thread a contiguous part of dst, in whole blocks
+  const std::uint64_t blocks = (M + BlockSize - 1) / BlockSize;
+  nthreads = static_cast<unsigned>(
+    std::max<std::uint64_t>(1, std::min<std::uint64_t>(nthreads, blocks)));
+  if (nthreads == 1) {
+    permute_copy_range(src, dst, perm, 0, M);
+    return;
+  }
+  std::vector<std::thread> threads;
+  threads.reserve(nthreads);
+  for (unsigned t = 0; t < nthreads; ++t) {
+    const std::uint64_t begin = std::min(M, blocks * t / nthreads * BlockSize);
+    const std::uint64_t end =
+      std::min(M, blocks * (t + 1) / nthreads * BlockSize);
+    threads.emplace_back([=]() {
+      permute_copy_range(src, dst, perm, begin, end);
+    });
+  }
+  for (auto& t : threads) {
+    t.join();
+  }
+}
+}
+
+/**
+ * copies the M records in src to dst in a random order given by seed, so
+ * that dst[i]=src[p(i)] where p is a permutation of [0,M).
+ *
+ * This is a replacement for copying and std::shuffle:ing, which does not need
+ * any extra memory, gives the same result for the same seed and M regardless
+ * of the number of threads, and can be split over threads since any position
+ * of the permutation can be calculated independently (see
+ * CycleWalkingPermutation).
+ * The destination is written sequentially, so the writes use non temporal
+ * stores when the record size and alignment permits.
+ *
+ * src and dst must not overlap. nthreads=0 means use all cores.
+ */
+template<typename Record>
+void
+permute_copy(const Record* src,
+             Record* dst,
+             std::uint64_t M,
+             std::uint64_t seed,
+             unsigned nthreads = 0)
+{
+  static_assert(std::is_trivially_copyable_v<Record>,
+                "records are copied bytewise");
+  if (nthreads == 0) {
+    nthreads = std::max(1U, std::thread::hardware_concurrency());
+  }
+  PermuteCopyInternals::permute_copy_impl(src, dst, M, seed, nthreads);
+}
@@ -0,0 +1,212 @@
+#pragma once
+/*
+ * By Paul Dreik 2019,2020
+ * https://www.pauldreik.se/
+ * License: Boost 1.0
+ * SPDX-License-Identifier: BSL-1.0
+ */
+#include <atomic>
+#include <cassert>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include <immintrin.h> // _mm_pause
+
+#include "CryptoForEach.h"
+#include "MpmcRing.h"
+
+struct PipelineOptions
+{
+  // number of threads invoking the callback
+  unsigned consumers = 1;
+  // number of indices handed over in one go
+  std::size_t batch_size = 4096;
+  // number of batches in flight. this is what bounds the memory use, and the
+  // producer blocks when all of them are in use (backpressure).
+  // must be a power of two.
+  std::size_t batches = 64;
+};
+
+struct PipelineStageStats
+{
+  std::uint64_t elements = 0;
+  std::uint64_t batches = 0;
+  // number of times the stage had to wait for the other side
+  std::uint64_t stalls = 0;
+  double seconds = 0;
+
+  double throughput() const { return seconds > 0 ? elements / seconds : 0; }
+};
+
+struct PipelineStats
+{
+  PipelineStageStats producer;
+  std::vector<PipelineStageStats> consumers;
+
+  void print(std::FILE* out) const
+  {
+    std::fprintf(out,
+                 "producer: %llu elements in %llu batches, %llu stalls, "
+                 "%.3g elements/s\n",
+                 static_cast<unsigned long long>(producer.elements),
+                 static_cast<unsigned long long>(producer.batches),
+                 static_cast<unsigned long long>(producer.stalls),
+                 producer.throughput());
+    for (std::size_t i = 0; i < consumers.size(); ++i) {
+      const auto& c = consumers[i];
+      std::fprintf(out,
+                   "consumer %zu: %llu elements in %llu batches, %llu stalls, "
+                   "%.3g elements/s\n",
+                   i,
+                   static_cast<unsigned long long>(c.elements),
+                   static_cast<unsigned long long>(c.batches),
+                   static_cast<unsigned long long>(c.stalls),
+                   c.throughput());
+    }
+  }
+};
+
+namespace PipelineInternals {
+// spins a little before giving up the time slice
+inline void
+backoff(unsigned& spins)
+{
+  if (++spins < 64) {
+    _mm_pause();
+  } else {
+    std::this_thread::yield();
+  }
+}
+}
+
+/**
+ * like crypto_for_each, but the permutation is generated on a separate
+ * producer thread and handed to opt.consumers threads which invoke cb.
+ * Each integer in [0,M) is still passed to cb exactly once, but from
+ * an unspecified consumer thread, so cb must be thread safe.
+ *
+ * The batches are allocated up front and recycled through a queue of free
+ * batches, so no allocation happens while running.
+ */
+template<typename Crypto, typename Integer, typename URBG, typename Callback>
+PipelineStats
+pipelined_for_each(Integer M,
+                   URBG&& rng,
+                   Callback&& cb,
+                   const PipelineOptions& opt = PipelineOptions{})
+{
+  using Clock = std::chrono::steady_clock;
+  assert(opt.consumers > 0);
+  assert(opt.batch_size > 0);
+
+  struct Batch
+  {
+    std::size_t size = 0;
+    std::unique_ptr<Integer[]> data;
+  };
+  std::vector<Batch> batches(opt.batches);
+  for (auto& b : batches) {
+    b.data.reset(new Integer[opt.batch_size]);
+  }
+
+  // batch indices cycle free -> full -> free. both queues can hold all
+  // batches, so a push never fails.
+  MpmcRing<std::uint32_t> free(opt.batches);
+  MpmcRing<std::uint32_t> full(opt.batches);
+  for (std::uint32_t i = 0; i < opt.batches; ++i) {
+    free.try_push(i);
+  }
+  std::atomic<bool> done{ false };
+
+  PipelineStats stats;
+  stats.consumers.resize(opt.consumers);
+  ForEachStats generation;
+
+  auto consumer = [&](PipelineStageStats& result) {
+    // count locally, the stats of the consumers share cache lines
+    PipelineStageStats s;
+    const auto start = Clock::now();
+    std::uint32_t index;
+    unsigned spins = 0;
+    for (;;) {
+      if (!full.try_pop(index)) {
+        // the producer sets done after the last push, so one more try
+        // after seeing done is enough to not miss anything.
+        if (done.load(std::memory_order_acquire)) {
+          if (!full.try_pop(index)) {
+            break;
+          }
+        } else {
+          ++s.stalls;
+          PipelineInternals::backoff(spins);
+          continue;
+        }
+      }
+      spins = 0;
+      Batch& b = batches[index];
+      const Integer* data = b.data.get();
+      for (std::size_t i = 0; i < b.size; ++i) {
+        cb(data[i]);
+      }
+      s.elements += b.size;
+      ++s.batches;
+      free.try_push(index);
+    }
+    s.seconds = std::chrono::duration<double>(Clock::now() - start).count();
+    result = s;
+  };
+
+  auto producer = [&]() {
+    auto& s = stats.producer;
+    const auto start = Clock::now();
+    unsigned spins = 0;
+    std::uint32_t index;
+    auto acquire = [&]() {
+      while (!free.try_pop(index)) {
+        ++s.stalls;
+        PipelineInternals::backoff(spins);
+      }
+      spins = 0;
+      batches[index].size = 0;
+    };
+    auto publish = [&]() {
+      s.elements += batches[index].size;
+      ++s.batches;
+      full.try_push(index);
+    };
+    acquire();
+    crypto_for_each<Crypto>(M, rng, [&](Integer value) {
+      Batch& b = batches[index];
+      b.data[b.size++] = value;
+      if (b.size == opt.batch_size) {
+        publish();
+        acquire();
+      }
+    });
+    // the driver stats are kept per thread, hand them over to the caller
+    generation = last_foreach_stats();
+    if (batches[index].size > 0) {
+      publish();
+    } else {
+      free.try_push(index);
+    }
+    s.seconds = std::chrono::duration<double>(Clock::now() - start).count();
+    done.store(true, std::memory_order_release);
+  };
+
+  std::vector<std::thread> threads;
+  threads.reserve(opt.consumers + 1);
+  threads.emplace_back(producer);
+  for (auto& s : stats.consumers) {
+    threads.emplace_back(consumer, std::ref(s));
+  }
+  for (auto& t : threads) {
+    t.join();
+  }
+  last_foreach_stats() = generation;
+  return stats;
+}
@@ -175,10 +175,18 @@ public:
     return hash;
   }
 
+  /// selects the round function for the given round, all are NONE
+  /// initially
+  void select(int round, RoundFuncs rf) { m_selector[round] = rf; }
+
   std::uint32_t applyAes(const std::uint32_t x) const
   {
-    static_assert(sizeof(m_key) >= 128 / 8, "key is too small");
-    auto key = _mm_loadu_si128((__m128i*)m_key.data());
+    // the first four round keys, repeated if there are fewer rounds
+    alignas(16) std::uint32_t words[4];
+    for (std::size_t i = 0; i < 4; ++i) {
+      words[i] = m_key[i % m_key.size()];
+    }
+    const __m128i key = _mm_load_si128((const __m128i*)words);
 
     __m128i m = _mm_set1_epi32(x);
     m = _mm_aesenc_si128(m, key);
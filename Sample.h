@@ -0,0 +1,140 @@
+#pragma once
+/*
+ * By Paul Dreik 2019,2020
+ * https://www.pauldreik.se/
+ * License: Boost 1.0
+ * SPDX-License-Identifier: BSL-1.0
+ */
+#include <algorithm>
+#include <cassert>
+#include <cstdint>
+#include <cstring>
+#include <iterator>
+#include <random>
+#include <vector>
+
+#include <immintrin.h>
+
+#include "CryptoForEach.h"
+#include "Fnv1aCiphers.h"
+#include "simdfeistel.h"
+
+namespace SampleInternals {
+template<typename Crypto, typename OutputIt>
+OutputIt
+sample_with(std::uint64_t k, std::uint64_t M, std::uint64_t seed, OutputIt out)
+{
+  Crypto cipher(even_bits_needed(M));
+  std::mt19937_64 rng(seed);
+  cipher.seed(rng);
+  for (std::uint64_t i = 0; k > 0; ++i) {
+    const std::uint64_t encrypted = cipher.encrypt(i);
+    if (encrypted < M) {
+      *out++ = encrypted;
+      --k;
+    }
+  }
+  return out;
+}
+
+// moves the lanes selected by mask to the front, keeping their order
+inline __m256i
+left_pack(__m256i x, unsigned mask)
+{
+  // expand each mask bit to a byte, and pick out the lane numbers to keep
+  const std::uint64_t bytemask = _pdep_u64(mask, 0x0101010101010101) * 0xFF;
+  const std::uint64_t lanes = _pext_u64(0x0706050403020100, bytemask);
+  const __m256i shuffle = _mm256_cvtepu8_epi32(_mm_cvtsi64_si128(lanes));
+  return _mm256_permutevar8x32_epi32(x, shuffle);
+}
+}
+
+/**
+ * writes k distinct values from [0,M) to out, in random order, and returns
+ * the end of the output. The values are the first k of the permutation
+ * which crypto_for_each would visit, so it takes O(k) time (less than 4k
+ * encryptions expected) and no memory besides the cipher, regardless of
+ * how large M is. The same seed gives the same sample.
+ *
+ * k must not be larger than M.
+ */
+template<typename OutputIt>
+OutputIt
+sample(std::uint64_t k, std::uint64_t M, std::uint64_t seed, OutputIt out)
+{
+  assert(k <= M);
+  // the 32 bit cipher is faster, use it when possible
+  if (even_bits_needed(M) <= 32) {
+    return SampleInternals::sample_with<Dynamic32>(k, M, seed, out);
+  }
+  return SampleInternals::sample_with<Dynamic64>(k, M, seed, out);
+}
+
+/**
+ * returns k distinct values from [0,M) in random order, see sample above
+ */
+inline std::vector<std::uint64_t>
+sample(std::uint64_t k, std::uint64_t M, std::uint64_t seed)
+{
+  std::vector<std::uint64_t> ret;
+  ret.reserve(k);
+  sample(k, M, seed, std::back_inserter(ret));
+  return ret;
+}
+
+/**
+ * simd version of sample, for M up to 2^32. Fills out[0..k) with distinct
+ * values from [0,M). Eight values are encrypted at a time with
+ * ParallelFeistel, and the ones in range are packed and stored together
+ * without branching on each lane.
+ *
+ * This uses another cipher than sample(), so the result for the same seed
+ * differs from it.
+ */
+inline void
+sample_fill(std::uint32_t* out, std::uint64_t k, std::uint64_t M, std::uint64_t seed)
+{
+  assert(k <= M);
+  assert(M <= (std::uint64_t{ 1 } << 32));
+  if (k == 0) {
+    return;
+  }
+  ParallelFeistel cipher(even_bits_needed(M));
+  std::mt19937_64 rng(seed);
+  cipher.seed(rng);
+
+  // unsigned comparison through signed, by flipping the sign bit
+  const __m256i flip = _mm256_set1_epi32(static_cast<int>(0x80000000U));
+  const __m256i limit = _mm256_xor_si256(
+    _mm256_set1_epi32(static_cast<int>(static_cast<std::uint32_t>(M))), flip);
+  const bool everything = M == (std::uint64_t{ 1 } << 32);
+
+  ManyU32 II(0, 1, 2, 3, 4, 5, 6, 7);
+  const ManyU32 lanes(8);
+  std::uint64_t written = 0;
+  for (;; II += lanes) {
+    const __m256i x = cipher.encrypt(II).m_x;
+    unsigned mask = 0xFF;
+    if (!everything) {
+      const __m256i inrange =
+        _mm256_cmpgt_epi32(limit, _mm256_xor_si256(x, flip));
+      mask = static_cast<unsigned>(
+        _mm256_movemask_ps(_mm256_castsi256_ps(inrange)));
+    }
+    const unsigned n = static_cast<unsigned>(__builtin_popcount(mask));
+    const __m256i packed = SampleInternals::left_pack(x, mask);
+    if (k - written >= 8) {
+      _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + written), packed);
+      written += n;
+    } else {
+      std::uint32_t tmp[8];
+      _mm256_storeu_si256(reinterpret_cast<__m256i*>(tmp), packed);
+      const std::uint64_t take = std::min<std::uint64_t>(n, k - written);
+      std::memcpy(out + written, tmp, take * sizeof(tmp[0]));
+      written += take;
+    }
+    if (written == k) {
+      return;
+    }
+  }
+}
@@ -0,0 +1,211 @@
+/*
+ * By Paul Dreik 2019,2020
+ * https://www.pauldreik.se/
+ * License: Boost 1.0
+ * SPDX-License-Identifier: BSL-1.0
+ */
+#pragma once
+
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <immintrin.h>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "CryptoForEach.h"
+#include "Fnv1aCiphers.h"
+#include "simdfeistel.h"
+
+/**
+ * how far a run has come, as the number of cipher counters encrypted so
+ * far. Because values outside [0,M) are skipped, this is in general larger
+ * than the number of values delivered, and the latter is not enough to
+ * answer queries. crypto_for_each_range passes the counter to the
+ * callback, after cb(counter, value) the checkpoint is counter+1.
+ */
+struct ForEachCheckpoint
+{
+  std::uint64_t counter = 0;
+};
+
+namespace VisitedQueryInternals {
+/**
+ * the simd cipher whose lanes give the same result as Crypto, or void if
+ * there is none
+ */
+template<typename Crypto>
+struct SimdTwin
+{
+  using type = void;
+};
+template<>
+struct SimdTwin<Dynamic32>
+{
+  using type = ParallelFeistel;
+};
+template<>
+struct SimdTwin<Dynamic64>
+{
+  using type = ParallelFeistel64;
+};
+
+/**
+ * remembers the numbers drawn from urbg, so they can be handed out again
+ * after rewind(). Used to seed two ciphers alike, also from generators
+ * like std::random_device that can not be copied.
+ */
+template<typename URBG>
+class Replay
+{
+public:
+  using result_type = typename URBG::result_type;
+  static constexpr result_type min() { return URBG::min(); }
+  static constexpr result_type max() { return URBG::max(); }
+  explicit Replay(URBG& urbg)
+    : m_urbg(urbg)
+  {}
+  result_type operator()()
+  {
+    if (m_pos == m_drawn.size()) {
+      m_drawn.push_back(m_urbg());
+    }
+    return m_drawn[m_pos++];
+  }
+  void rewind() { m_pos = 0; }
+
+private:
+  URBG& m_urbg;
+  std::vector<result_type> m_drawn;
+  std::size_t m_pos = 0;
+};
+}
+
+/**
+ * @brief The VisitedQuery class
+ * Answers whether a value was already delivered by a run over [0,M) that
+ * has reached a checkpoint, without any memory of what was delivered.
+ * Value v is delivered at the counter decrypt(v), so it has been visited
+ * if decrypt(v) < checkpoint.counter.
+ *
+ * Construct it with the same M and random generator state as the run was
+ * seeded with. For Dynamic32 and Dynamic64 the batch query decrypts a
+ * simd register of values at a time.
+ */
+template<typename Crypto>
+class VisitedQuery
+{
+public:
+  template<typename URBG>
+  VisitedQuery(std::uint64_t M, URBG&& urbg)
+    : m_M(M)
+    , m_bits(even_bits_needed(M))
+    , m_cipher(m_bits)
+    , m_simd(m_bits)
+  {
+    VisitedQueryInternals::Replay<std::remove_reference_t<URBG>> replay(urbg);
+    m_cipher.seed(replay);
+    if constexpr (HasSimd) {
+      replay.rewind();
+      m_simd.seed(replay);
+    }
+  }
+
+  std::uint64_t size() const { return m_M; }
+
+  bool was_visited(std::uint64_t value, ForEachCheckpoint checkpoint)
+  {
+    assert(value < m_M);
+    return m_cipher.decrypt(static_cast<Full>(value)) < checkpoint.counter;
+  }
+
+  /**
+   * sets visited[i] to 1 if values[i] was visited, otherwise 0, for i in
+   * [0,n). returns the number of visited values.
+   */
+  template<typename Integer>
+  std::size_t was_visited(const Integer* values,
+                          std::size_t n,
+                          ForEachCheckpoint checkpoint,
+                          std::uint8_t* visited)
+  {
+    std::size_t i = 0;
+    std::size_t count = 0;
+    const bool complete =
+      m_bits < 64 && checkpoint.counter >= (std::uint64_t{ 1 } << m_bits);
+    if (complete) {
+      for (; i < n; ++i) {
+        visited[i] = 1;
+      }
+      return n;
+    }
+    if constexpr (HasSimd) {
+      count += was_visited_simd(values, n, checkpoint, visited, i);
+    }
+    for (; i < n; ++i) {
+      visited[i] = was_visited(values[i], checkpoint);
+      count += visited[i];
+    }
+    return count;
+  }
+
+private:
+  using Simd = typename VisitedQueryInternals::SimdTwin<Crypto>::type;
+  static constexpr bool HasSimd = !std::is_void_v<Simd>;
+  // a placeholder when there is no simd twin
+  struct NoSimd
+  {
+    explicit NoSimd(int) {}
+  };
+  using Full = decltype(std::declval<Crypto&>().decrypt(0));
+
+  /**
+   * the full batches, advances i past them. the checkpoint is known to be
+   * within the counter range here.
+   */
+  template<typename Integer>
+  std::size_t was_visited_simd(const Integer* values,
+                               std::size_t n,
+                               ForEachCheckpoint checkpoint,
+                               std::uint8_t* visited,
+                               std::size_t& i)
+  {
+    using Vec = typename Simd::Vec;
+    using Lane = typename Vec::Int;
+    constexpr int L = Vec::size();
+    // unsigned comparison through signed, by flipping the sign bit
+    const Lane sign = Lane{ 1 } << (8 * sizeof(Lane) - 1);
+    const Vec flip{ sign };
+    const Vec limit = Vec{ static_cast<Lane>(checkpoint.counter) } ^ flip;
+    std::size_t count = 0;
+    for (; i + L <= n; i += L) {
+      Lane lanes[L];
+      for (int j = 0; j < L; ++j) {
+        assert(values[i + j] < m_M);
+        lanes[j] = static_cast<Lane>(values[i + j]);
+      }
+      const Vec x{ _mm256_loadu_si256((const __m256i*)lanes) };
+      const __m256i d = (m_simd.decrypt(x) ^ flip).m_x;
+      unsigned mask;
+      if constexpr (sizeof(Lane) == 4) {
+        mask = static_cast<unsigned>(_mm256_movemask_ps(
+          _mm256_castsi256_ps(_mm256_cmpgt_epi32(limit.m_x, d))));
+      } else {
+        mask = static_cast<unsigned>(_mm256_movemask_pd(
+          _mm256_castsi256_pd(_mm256_cmpgt_epi64(limit.m_x, d))));
+      }
+      // spread the mask bits into one byte each
+      const std::uint64_t bytes = _pdep_u64(mask, 0x0101010101010101ULL);
+      std::memcpy(visited + i, &bytes, L);
+      count += static_cast<std::size_t>(__builtin_popcount(mask));
+    }
+    return count;
+  }
+
+  std::uint64_t m_M;
+  int m_bits;
+  Crypto m_cipher;
+  std::conditional_t<HasSimd, Simd, NoSimd> m_simd;
+};
@@ -0,0 +1,233 @@
+/*
+ * By Paul Dreik 2019,2020
+ * https://www.pauldreik.se/
+ * License: Boost 1.0
+ * SPDX-License-Identifier: BSL-1.0
+ */
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+// empty test function in another translation unit (donothing.cpp)
+void
+donothing(unsigned int);
+
+/**
+ * @brief The Workload class
+ * What shootout does with each visited value, so the orders can be
+ * compared under some load and not only on iteration overhead. Each kind
+ * ends with passing a result to donothing, like the default does with the
+ * value itself, so nothing is optimized away.
+ *
+ * - none: just donothing(x)
+ * - array_read: reads element x of an array of N elements
+ * - array_write: writes element x of an array of N elements
+ * - histogram: atomic increment of bin x/8 of a histogram of N/8 bins,
+ *   while the other cores increment the same histogram sequentially
+ * - hash: a chain of multiply-xorshift rounds, bound by compute
+ * - parser: a state machine over the nibbles of x, with data dependent
+ *   branches
+ *
+ * The array is rounded up to a power of two and indexed with x masked, so
+ * values out of range (some of the shootout functions combine several
+ * values into one) stay within bounds. The switch on the kind is the same
+ * for every call, so it is predicted. Calls may come from several threads,
+ * as long as they are for different values.
+ *
+ * The histogram contenders run between start() and stop(), which shootout
+ * calls around the timed function only. They keep all but one core busy,
+ * so the multithreaded engines compete with them for the cores, and a
+ * profiler counting the whole process counts them too.
+ */
+class Workload
+{
+public:
+  enum Kind
+  {
+    None,
+    ArrayRead,
+    ArrayWrite,
+    Histogram,
+    Hash,
+    Parser
+  };
+  static constexpr int Kinds = Parser + 1;
+
+  static const char* name(Kind kind)
+  {
+    constexpr const char* names[Kinds] = { "none",      "array_read",
+                                           "array_write", "histogram",
+                                           "hash",        "parser" };
+    return names[kind];
+  }
+
+  /// the kind with the given name, exits if there is none
+  static Kind from_name(const std::string& name)
+  {
+    for (int k = 0; k < Kinds; ++k) {
+      if (name == Workload::name(static_cast<Kind>(k))) {
+        return static_cast<Kind>(k);
+      }
+    }
+    std::puts("could not find that workload");
+    std::exit(EXIT_FAILURE);
+  }
+
+  Workload(Kind kind, std::uint64_t N)
+    : m_kind(kind)
+  {
+    while (N > 1 && m_mask < N - 1) {
+      m_mask = 2 * m_mask + 1;
+    }
+    switch (kind) {
+      case ArrayRead:
+      case ArrayWrite:
+        m_array.reset(new std::uint32_t[m_mask + 1]);
+        std::memset(m_array.get(), 0, (m_mask + 1) * sizeof(std::uint32_t));
+        break;
+      case Histogram: {
+        m_bins = m_mask / 8 + 1;
+        m_histogram.reset(new std::atomic<std::uint32_t>[m_bins]);
+        for (std::uint64_t i = 0; i < m_bins; ++i) {
+          m_histogram[i].store(0, std::memory_order_relaxed);
+        }
+        break;
+      }
+      default:
+        break;
+    }
+  }
+  Workload(const Workload&) = delete;
+  Workload& operator=(const Workload&) = delete;
+  ~Workload() { stop(); }
+
+  /// starts the contenders of the histogram, if that is the kind
+  void start()
+  {
+    if (m_kind != Histogram || !m_contenders.empty()) {
+      return;
+    }
+    m_stop = false;
+    const unsigned cores = std::thread::hardware_concurrency();
+    for (unsigned t = 1; t < cores; ++t) {
+      m_contenders.emplace_back([this, t]() { contend(t); });
+    }
+  }
+
+  /// stops and joins the contenders
+  void stop()
+  {
+    m_stop = true;
+    for (auto& t : m_contenders) {
+      t.join();
+    }
+    m_contenders.clear();
+  }
+
+  void operator()(std::uint64_t x)
+  {
+    switch (m_kind) {
+      case None:
+        donothing(static_cast<unsigned>(x));
+        return;
+      case ArrayRead:
+        donothing(m_array[x & m_mask]);
+        return;
+      case ArrayWrite:
+        m_array[x & m_mask] = static_cast<std::uint32_t>(x);
+        return;
+      case Histogram:
+        m_histogram[(x & m_mask) / 8].fetch_add(1, std::memory_order_relaxed);
+        return;
+      case Hash:
+        donothing(static_cast<unsigned>(hash(x)));
+        return;
+      case Parser:
+        donothing(parse(static_cast<std::uint32_t>(x)));
+        return;
+    }
+  }
+
+  static std::uint64_t hash(std::uint64_t x)
+  {
+    for (int i = 0; i < 8; ++i) {
+      x ^= x >> 31;
+      x *= 0x9e3779b97f4a7c15;
+      x ^= x >> 29;
+    }
+    return x;
+  }
+
+  /**
+   * reads the nibbles of x as characters: 0-9 are digits, 10-12 letters,
+   * 13 a space, 14 an operator and 15 the end of the input. counts the
+   * tokens and evaluates the last number.
+   */
+  static unsigned parse(std::uint32_t x)
+  {
+    unsigned tokens = 0;
+    unsigned value = 0;
+    enum
+    {
+      Blank,
+      Number,
+      Word
+    } state = Blank;
+    for (int i = 0; i < 8; ++i, x >>= 4) {
+      const unsigned c = x & 0xF;
+      if (c < 10) {
+        if (state != Number) {
+          ++tokens;
+          value = 0;
+        }
+        value = value * 10 + c;
+        state = Number;
+      } else if (c < 13) {
+        if (state != Word) {
+          ++tokens;
+        }
+        state = Word;
+      } else if (c == 13) {
+        state = Blank;
+      } else if (c == 14) {
+        ++tokens;
+        state = Blank;
+      } else {
+        break;
+      }
+    }
+    return tokens * 100000000 + value;
+  }
+
+private:
+  // hammers the histogram in sequential order, from another core
+  void contend(unsigned offset)
+  {
+    std::uint64_t bin = m_bins * offset / std::thread::hardware_concurrency();
+    while (!m_stop.load(std::memory_order_relaxed)) {
+      for (int i = 0; i < 1024; ++i) {
+        m_histogram[bin].fetch_add(1, std::memory_order_relaxed);
+        if (++bin == m_bins) {
+          bin = 0;
+        }
+      }
+    }
+  }
+
+  const Kind m_kind;
+  std::uint64_t m_mask = 0;
+  std::unique_ptr<std::uint32_t[]> m_array;
+  std::unique_ptr<std::atomic<std::uint32_t>[]> m_histogram;
+  std::uint64_t m_bins = 0;
+  std::vector<std::thread> m_contenders;
+  std::atomic<bool> m_stop{ false };
+};
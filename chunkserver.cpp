@@ -0,0 +1,775 @@
+/*
+ * Hands out chunks of a random order of [0,M) to worker processes on the
+ * same host, so a slow worker does not hold up the others like it does
+ * with static shards:
+ *
+ *   chunkserver serve --socket /tmp/cs --count 1e9 --seed 1234 --log run.log
+ *   chunkserver work --socket /tmp/cs --processes 8 plugin.so
+ *
+ * The server owns the keyed permutation, the same as forkrunner uses
+ * (crypto_for_each_range over Dynamic32 or Dynamic64 seeded through
+ * std::mt19937_64). The cipher counters [0,2^bits) are cut in chunks, and
+ * a worker asks for the next chunk when it has completed the previous one,
+ * a single round trip over a unix seqpacket socket per chunk. The key is
+ * sent once when the worker connects, so each worker encrypts its chunks
+ * itself.
+ *
+ * Each chunk is run in a forked child of the worker, the same way
+ * forkrunner runs its batches: the child stores the counter it tests in
+ * memory shared with the worker, and when it dies the worker reports the
+ * counter and value it died on and resumes the chunk at the next counter.
+ * A crash in the test function thus only skips the crashing value.
+ *
+ * A worker that disconnects before completing its chunk, for instance by
+ * being killed, has the chunk handed out again. A chunk that takes down
+ * more than --retries workers is given up and reported. Completed chunks are
+ * appended to the log as 64 bit chunk numbers after a short header, and a
+ * server started with the same log skips them, so an interrupted run can
+ * be resumed.
+ *
+ * Workers load a test function from a shared object, the same interface
+ * as forkrunner:
+ *
+ *   extern "C" int random_foreach_test(std::uint64_t value);
+ *
+ * With --processes N, the worker forks N processes and replaces those that
+ * die, until the server is done.
+ *
+ * By Paul Dreik 2019,2020
+ * https://www.pauldreik.se/
+ * License: Boost 1.0
+ * SPDX-License-Identifier: BSL-1.0
+ */
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cinttypes>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <map>
+#include <new>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <dlfcn.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "CryptoForEach.h"
+#include "Fnv1aCiphers.h"
+
+namespace {
+
+using TestFunction = int (*)(std::uint64_t);
+
+constexpr std::uint64_t NoChunk = ~std::uint64_t{ 0 };
+
+struct Options
+{
+  std::string socket;
+  // serve
+  std::uint64_t count = 0;
+  std::uint64_t seed = 0;
+  std::uint64_t chunk = 1U << 20;
+  unsigned retries = 3;
+  std::string log;
+  // work
+  std::string plugin;
+  unsigned processes = 1;
+};
+
+enum class MessageType : std::uint32_t
+{
+  // server to worker when connecting, with count and seed
+  Hello,
+  // worker to server, with the chunk just completed or NoChunk
+  Request,
+  // server to worker, with the chunk and its counters [begin,end)
+  Chunk,
+  // server to worker, there is nothing more to do
+  Finished
+};
+
+/**
+ * the only message, in both directions. Server and workers run on the same
+ * host, so it is sent as is.
+ */
+struct Message
+{
+  MessageType type;
+  std::uint32_t unused = 0;
+  std::uint64_t count = 0;
+  std::uint64_t seed = 0;
+  std::uint64_t chunk = NoChunk;
+  std::uint64_t begin = 0;
+  std::uint64_t end = 0;
+};
+
+/// starts the completion log
+struct LogHeader
+{
+  char magic[8] = { 'r', 'f', 'c', 'h', 'u', 'n', 'k', '1' };
+  std::uint64_t count = 0;
+  std::uint64_t seed = 0;
+  std::uint64_t chunk = 0;
+};
+
+void
+usage()
+{
+  std::puts("usage: chunkserver serve --socket PATH --count M [--seed S] "
+            "[--chunk COUNTERS] [--retries R] [--log FILE]");
+  std::puts("       chunkserver work --socket PATH [--processes N] "
+            "plugin.so");
+  std::puts("M may be written as 1e9 and be at most 2^62.");
+  std::exit(EXIT_FAILURE);
+}
+
+sockaddr_un
+socket_address(const std::string& path)
+{
+  sockaddr_un addr{};
+  addr.sun_family = AF_UNIX;
+  if (path.size() >= sizeof(addr.sun_path)) {
+    std::puts("the socket path is too long");
+    std::exit(EXIT_FAILURE);
+  }
+  std::memcpy(addr.sun_path, path.c_str(), path.size());
+  return addr;
+}
+
+/// false if the peer is gone
+bool
+send_message(int fd, const Message& msg)
+{
+  for (;;) {
+    const ssize_t n = ::send(fd, &msg, sizeof(msg), MSG_NOSIGNAL);
+    if (n == sizeof(msg)) {
+      return true;
+    }
+    if (n < 0 && errno == EINTR) {
+      continue;
+    }
+    return false;
+  }
+}
+
+/// false if the peer is gone
+bool
+receive_message(int fd, Message& msg)
+{
+  for (;;) {
+    const ssize_t n = ::recv(fd, &msg, sizeof(msg), 0);
+    if (n == sizeof(msg)) {
+      return true;
+    }
+    if (n < 0 && errno == EINTR) {
+      continue;
+    }
+    return false;
+  }
+}
+
+/**
+ * keeps track of which chunks are done, and appends to the completion log
+ */
+class Chunks
+{
+public:
+  Chunks(const Options& opt, std::uint64_t counters)
+    : m_chunk(opt.chunk)
+    , m_counters(counters)
+    , m_total((counters - 1) / opt.chunk + 1)
+    , m_done(m_total)
+  {
+    if (!opt.log.empty()) {
+      open_log(opt);
+    }
+    for (std::uint64_t c = 0; c < m_total; ++c) {
+      if (!m_done[c]) {
+        m_pending.push_back(c);
+      }
+    }
+  }
+  ~Chunks()
+  {
+    if (m_log >= 0) {
+      ::close(m_log);
+    }
+  }
+
+  std::uint64_t total() const { return m_total; }
+  std::uint64_t completed() const { return m_completed; }
+  std::uint64_t abandoned() const { return m_abandoned; }
+  std::uint64_t reissued() const { return m_reissued; }
+  bool finished() const { return m_completed + m_abandoned == m_total; }
+
+  /// the next chunk to hand out, or NoChunk
+  std::uint64_t next()
+  {
+    if (m_pending.empty()) {
+      return NoChunk;
+    }
+    const std::uint64_t c = m_pending.front();
+    m_pending.pop_front();
+    return c;
+  }
+
+  Message message(std::uint64_t c) const
+  {
+    Message msg{ MessageType::Chunk };
+    msg.chunk = c;
+    msg.begin = c * m_chunk;
+    msg.end = m_counters - msg.begin > m_chunk ? msg.begin + m_chunk
+                                               : m_counters;
+    return msg;
+  }
+
+  void complete(std::uint64_t c)
+  {
+    if (m_done[c]) {
+      return;
+    }
+    m_done[c] = true;
+    ++m_completed;
+    if (m_log >= 0 && ::write(m_log, &c, sizeof(c)) != sizeof(c)) {
+      std::perror("writing the completion log");
+      std::exit(EXIT_FAILURE);
+    }
+  }
+
+  /// the worker running c is gone
+  void lost(std::uint64_t c, unsigned retries)
+  {
+    if (m_done[c]) {
+      return;
+    }
+    if (++m_lost[c] > retries) {
+      const Message msg = message(c);
+      std::printf("abandoned chunk=%" PRIu64 " counters=[%" PRIu64
+                  ",%" PRIu64 ") after %u lost workers\n",
+                  c,
+                  msg.begin,
+                  msg.end,
+                  m_lost[c]);
+      std::fflush(stdout);
+      ++m_abandoned;
+      return;
+    }
+    ++m_reissued;
+    // first, so it is not left until the end
+    m_pending.push_front(c);
+  }
+
+private:
+  void open_log(const Options& opt)
+  {
+    m_log = ::open(opt.log.c_str(), O_RDWR | O_CREAT | O_APPEND, 0644);
+    if (m_log < 0) {
+      std::perror("opening the completion log");
+      std::exit(EXIT_FAILURE);
+    }
+    LogHeader expected;
+    expected.count = opt.count;
+    expected.seed = opt.seed;
+    expected.chunk = opt.chunk;
+    LogHeader header;
+    const ssize_t n = ::read(m_log, &header, sizeof(header));
+    if (n == 0) {
+      if (::write(m_log, &expected, sizeof(expected)) != sizeof(expected)) {
+        std::perror("writing the completion log");
+        std::exit(EXIT_FAILURE);
+      }
+      return;
+    }
+    if (n != sizeof(header) ||
+        std::memcmp(&header, &expected, sizeof(header)) != 0) {
+      std::puts("the completion log is for another count, seed or chunk");
+      std::exit(EXIT_FAILURE);
+    }
+    std::uint64_t c;
+    while (::read(m_log, &c, sizeof(c)) == sizeof(c)) {
+      if (c < m_total && !m_done[c]) {
+        m_done[c] = true;
+        ++m_completed;
+      }
+    }
+    if (m_completed > 0) {
+      std::printf("resuming with %" PRIu64 " of %" PRIu64
+                  " chunks completed\n",
+                  m_completed,
+                  m_total);
+    }
+  }
+
+  const std::uint64_t m_chunk;
+  const std::uint64_t m_counters;
+  const std::uint64_t m_total;
+  std::vector<bool> m_done;
+  std::deque<std::uint64_t> m_pending;
+  // lost workers per chunk, for the few chunks that lost any
+  std::map<std::uint64_t, unsigned> m_lost;
+  std::uint64_t m_completed = 0;
+  std::uint64_t m_abandoned = 0;
+  std::uint64_t m_reissued = 0;
+  int m_log = -1;
+};
+
+struct Worker
+{
+  int fd;
+  // the chunk it runs
+  std::uint64_t chunk = NoChunk;
+  // asked for a chunk while there was none
+  bool waiting = false;
+};
+
+int
+serve(const Options& opt)
+{
+  const std::uint64_t counters = std::uint64_t{ 1 }
+                                 << even_bits_needed(opt.count);
+  Chunks chunks(opt, counters);
+
+  const int listener =
+    ::socket(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC | SOCK_NONBLOCK, 0);
+  const sockaddr_un addr = socket_address(opt.socket);
+  ::unlink(opt.socket.c_str());
+  const auto* sa = reinterpret_cast<const sockaddr*>(&addr);
+  if (listener < 0 || ::bind(listener, sa, sizeof(addr)) != 0 ||
+      ::listen(listener, SOMAXCONN) != 0) {
+    std::perror("listening on the socket");
+    return EXIT_FAILURE;
+  }
+
+  const std::uint64_t resumed = chunks.completed();
+  const auto start = std::chrono::steady_clock::now();
+  std::vector<Worker> workers;
+  std::vector<pollfd> fds;
+  std::uint64_t connections = 0;
+
+  // hands out the next chunk, or tells the worker to wait or stop
+  auto assign = [&](Worker& w) {
+    w.waiting = false;
+    w.chunk = chunks.next();
+    if (w.chunk != NoChunk) {
+      return send_message(w.fd, chunks.message(w.chunk));
+    }
+    if (chunks.finished()) {
+      return send_message(w.fd, Message{ MessageType::Finished });
+    }
+    w.waiting = true;
+    return true;
+  };
+  auto drop = [&](Worker& w) {
+    if (w.chunk != NoChunk) {
+      chunks.lost(w.chunk, opt.retries);
+    }
+    ::close(w.fd);
+    w.fd = -1;
+  };
+
+  while (!chunks.finished()) {
+    fds.clear();
+    fds.push_back({ listener, POLLIN, 0 });
+    for (const auto& w : workers) {
+      fds.push_back({ w.fd, POLLIN, 0 });
+    }
+    if (::poll(fds.data(), fds.size(), -1) < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      std::perror("poll");
+      return EXIT_FAILURE;
+    }
+
+    for (std::size_t i = 0; i < workers.size(); ++i) {
+      Worker& w = workers[i];
+      if (fds[i + 1].revents == 0) {
+        continue;
+      }
+      Message msg;
+      if (!receive_message(w.fd, msg) || msg.type != MessageType::Request) {
+        drop(w);
+        continue;
+      }
+      if (msg.chunk != NoChunk && msg.chunk == w.chunk) {
+        chunks.complete(w.chunk);
+      }
+      w.chunk = NoChunk;
+      if (!assign(w)) {
+        drop(w);
+      }
+    }
+
+    if (fds[0].revents & POLLIN) {
+      int fd;
+      while ((fd = ::accept4(listener, nullptr, nullptr, SOCK_CLOEXEC)) >= 0) {
+        Message hello{ MessageType::Hello };
+        hello.count = opt.count;
+        hello.seed = opt.seed;
+        if (send_message(fd, hello)) {
+          workers.push_back(Worker{ fd });
+          ++connections;
+        } else {
+          ::close(fd);
+        }
+      }
+    }
+
+    // chunks from lost workers go to those waiting
+    for (auto& w : workers) {
+      if (w.fd >= 0 && w.waiting && !assign(w)) {
+        drop(w);
+      }
+    }
+    workers.erase(std::remove_if(workers.begin(),
+                                 workers.end(),
+                                 [](const Worker& w) { return w.fd < 0; }),
+                  workers.end());
+  }
+
+  for (auto& w : workers) {
+    if (w.waiting) {
+      send_message(w.fd, Message{ MessageType::Finished });
+    }
+    ::close(w.fd);
+  }
+  ::close(listener);
+  ::unlink(opt.socket.c_str());
+
+  const std::chrono::duration<double> elapsed =
+    std::chrono::steady_clock::now() - start;
+  std::printf("completed %" PRIu64 " of %" PRIu64 " chunks in %.3f s "
+              "(%.3g counters/s), %" PRIu64 " reissued, %" PRIu64
+              " abandoned, %" PRIu64 " worker connections\n",
+              chunks.completed(),
+              chunks.total(),
+              elapsed.count(),
+              static_cast<double>(chunks.completed() - resumed) * opt.chunk /
+                elapsed.count(),
+              chunks.reissued(),
+              chunks.abandoned(),
+              connections);
+  return chunks.abandoned() == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+/**
+ * lives in memory shared between a worker and the child running its chunk
+ */
+struct SharedProgress
+{
+  // the counter currently being tested by the child, end once it is done
+  std::atomic<std::uint64_t> counter;
+  // set before the first test of a child, so counter means something
+  std::atomic<bool> started;
+  // number of values for which the test function returned nonzero
+  std::atomic<std::uint64_t> failures;
+};
+
+// children in a row that may die before testing anything, per chunk
+constexpr unsigned MaxRetries = 3;
+
+/**
+ * runs the counters [begin,end) in a child process, and in a new one
+ * after the crashing counter each time the child dies. A child that dies
+ * before testing anything is run again from where it started, and after
+ * MaxRetries of those in a row the worker gives up. returns the number of
+ * crashes.
+ */
+template<typename Crypto>
+std::uint64_t
+run_chunk(Crypto& cipher,
+          std::uint64_t M,
+          TestFunction test,
+          SharedProgress& progress,
+          std::uint64_t begin,
+          std::uint64_t end)
+{
+  std::uint64_t crashes = 0;
+  unsigned retries = 0;
+  while (begin < end) {
+    progress.counter.store(begin);
+    progress.started.store(false);
+    std::fflush(stdout);
+    const pid_t pid = ::fork();
+    if (pid < 0) {
+      std::perror("fork");
+      std::exit(EXIT_FAILURE);
+    }
+    if (pid == 0) {
+      auto cb = [&](std::uint64_t counter, std::uint64_t value) {
+        progress.counter.store(counter, std::memory_order_relaxed);
+        progress.started.store(true, std::memory_order_relaxed);
+        if (test(value) != 0) {
+          progress.failures.fetch_add(1, std::memory_order_relaxed);
+          std::printf(
+            "failure counter=%" PRIu64 " value=%" PRIu64 "\n", counter, value);
+          std::fflush(stdout);
+        }
+      };
+      crypto_for_each_range(cipher, M, begin, end, cb);
+      progress.counter.store(end);
+      std::_Exit(EXIT_SUCCESS);
+    }
+    int status = 0;
+    while (::waitpid(pid, &status, 0) < 0) {
+      if (errno != EINTR) {
+        std::perror("waitpid");
+        std::exit(EXIT_FAILURE);
+      }
+    }
+    const std::uint64_t counter = progress.counter.load();
+    if (WIFEXITED(status) && WEXITSTATUS(status) == EXIT_SUCCESS &&
+        counter == end) {
+      break;
+    }
+    if (!progress.started.load()) {
+      // no value to blame, run the same counters again
+      if (++retries > MaxRetries) {
+        std::printf("the child died %u times before testing anything "
+                    "at counter=%" PRIu64 "\n",
+                    retries,
+                    begin);
+        std::fflush(stdout);
+        std::exit(EXIT_FAILURE);
+      }
+      continue;
+    }
+    retries = 0;
+    ++crashes;
+    if (WIFSIGNALED(status)) {
+      std::printf("crash counter=%" PRIu64 " value=%" PRIu64 " signal=%d\n",
+                  counter,
+                  std::uint64_t{ cipher.encrypt(counter) },
+                  WTERMSIG(status));
+    } else {
+      std::printf("crash counter=%" PRIu64 " value=%" PRIu64 " exit=%d\n",
+                  counter,
+                  std::uint64_t{ cipher.encrypt(counter) },
+                  WEXITSTATUS(status));
+    }
+    begin = counter + 1;
+  }
+  return crashes;
+}
+
+template<typename Crypto>
+int
+work_chunks(int fd,
+            const Message& hello,
+            TestFunction test,
+            SharedProgress& progress)
+{
+  Crypto cipher(even_bits_needed(hello.count));
+  std::mt19937_64 rng(hello.seed);
+  cipher.seed(rng);
+
+  std::uint64_t crashes = 0;
+  Message request{ MessageType::Request };
+  for (;;) {
+    Message msg;
+    if (!send_message(fd, request) || !receive_message(fd, msg)) {
+      std::puts("lost the connection to the server");
+      return EXIT_FAILURE;
+    }
+    if (msg.type == MessageType::Finished) {
+      break;
+    }
+    crashes +=
+      run_chunk(cipher, hello.count, test, progress, msg.begin, msg.end);
+    request.chunk = msg.chunk;
+  }
+  return crashes + progress.failures.load() == 0 ? EXIT_SUCCESS
+                                                 : EXIT_FAILURE;
+}
+
+/**
+ * one worker process, connected to the server until it is done. a
+ * replacement for a dead worker may find the server already done and gone.
+ */
+int
+work(const Options& opt, TestFunction test, bool replacement)
+{
+  const int fd = ::socket(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0);
+  const sockaddr_un addr = socket_address(opt.socket);
+  if (fd < 0 ||
+      ::connect(fd, reinterpret_cast<const sockaddr*>(&addr), sizeof(addr)) !=
+        0) {
+    if (replacement && (errno == ENOENT || errno == ECONNREFUSED)) {
+      return EXIT_SUCCESS;
+    }
+    std::perror("connecting to the server");
+    return EXIT_FAILURE;
+  }
+  Message hello;
+  if (!receive_message(fd, hello) || hello.type != MessageType::Hello) {
+    // the server finished before this worker got going
+    ::close(fd);
+    return EXIT_SUCCESS;
+  }
+  void* mem = ::mmap(nullptr,
+                     sizeof(SharedProgress),
+                     PROT_READ | PROT_WRITE,
+                     MAP_SHARED | MAP_ANONYMOUS,
+                     -1,
+                     0);
+  if (mem == MAP_FAILED) {
+    std::perror("mmap");
+    return EXIT_FAILURE;
+  }
+  auto& progress = *new (mem) SharedProgress{};
+  const int ret = even_bits_needed(hello.count) <= 32
+                    ? work_chunks<Dynamic32>(fd, hello, test, progress)
+                    : work_chunks<Dynamic64>(fd, hello, test, progress);
+  ::munmap(mem, sizeof(SharedProgress));
+  ::close(fd);
+  return ret;
+}
+
+/**
+ * runs opt.processes workers, replacing the ones killed by a signal. a
+ * worker that exits is done, since the server has nothing more to give.
+ * crashes in the test function are handled within the worker, so this is
+ * for workers killed from the outside.
+ */
+int
+supervise(const Options& opt, TestFunction test)
+{
+  auto spawn = [&](bool replacement) {
+    std::fflush(stdout);
+    const pid_t pid = ::fork();
+    if (pid < 0) {
+      std::perror("fork");
+      std::exit(EXIT_FAILURE);
+    }
+    if (pid == 0) {
+      std::_Exit(work(opt, test, replacement));
+    }
+  };
+  for (unsigned p = 0; p < opt.processes; ++p) {
+    spawn(false);
+  }
+  int ret = EXIT_SUCCESS;
+  for (unsigned running = opt.processes; running > 0;) {
+    int status = 0;
+    const pid_t pid = ::wait(&status);
+    if (pid < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      std::perror("wait");
+      return EXIT_FAILURE;
+    }
+    if (WIFSIGNALED(status)) {
+      std::printf("worker died with signal %d\n", WTERMSIG(status));
+      spawn(true);
+      continue;
+    }
+    --running;
+    if (WEXITSTATUS(status) != EXIT_SUCCESS) {
+      ret = EXIT_FAILURE;
+    }
+  }
+  return ret;
+}
+}
+
+int
+main(int argc, char* argv[])
+{
+  if (argc < 2) {
+    usage();
+  }
+  const std::string mode{ argv[1] };
+  Options opt;
+  std::vector<std::string> positional;
+  // malformed numbers throw from std::sto*
+  try {
+    for (int i = 2; i < argc; ++i) {
+      const std::string arg{ argv[i] };
+      auto value = [&]() {
+        if (i + 1 >= argc) {
+          usage();
+        }
+        return std::string(argv[++i]);
+      };
+      if (arg == "--socket") {
+        opt.socket = value();
+      } else if (arg == "--count") {
+        // accept 1e9 as well as 1000000000, exactly
+        const std::string v = value();
+        if (v.find_first_of("eE.") != std::string::npos) {
+          const long double c = std::stold(v);
+          // out of range would be undefined in the conversion
+          if (!(c >= 0 && c <= static_cast<long double>(1ULL << 62))) {
+            usage();
+          }
+          opt.count = static_cast<std::uint64_t>(c);
+        } else {
+          opt.count = std::stoull(v);
+        }
+      } else if (arg == "--seed") {
+        opt.seed = std::stoull(value());
+      } else if (arg == "--chunk") {
+        opt.chunk = std::stoull(value());
+      } else if (arg == "--retries") {
+        opt.retries = static_cast<unsigned>(std::stoul(value()));
+      } else if (arg == "--log") {
+        opt.log = value();
+      } else if (arg == "--processes") {
+        opt.processes = static_cast<unsigned>(std::stoul(value()));
+      } else if (arg.size() > 1 && arg[0] == '-') {
+        usage();
+      } else {
+        positional.push_back(arg);
+      }
+    }
+  } catch (const std::logic_error&) {
+    usage();
+  }
+  if (opt.socket.empty()) {
+    usage();
+  }
+
+  if (mode == "serve") {
+    if (!positional.empty() || opt.count == 0 ||
+        opt.count > (std::uint64_t{ 1 } << 62) || opt.chunk == 0) {
+      usage();
+    }
+    return serve(opt);
+  }
+  if (mode != "work" || positional.size() != 1 || opt.processes == 0) {
+    usage();
+  }
+  opt.plugin = positional[0];
+  // dlopen needs a path, or it searches the library path
+  if (opt.plugin.find('/') == std::string::npos) {
+    opt.plugin = "./" + opt.plugin;
+  }
+  void* handle = ::dlopen(opt.plugin.c_str(), RTLD_NOW);
+  if (!handle) {
+    std::fprintf(stderr, "could not load plugin: %s\n", ::dlerror());
+    return EXIT_FAILURE;
+  }
+  auto test =
+    reinterpret_cast<TestFunction>(::dlsym(handle, "random_foreach_test"));
+  if (!test) {
+    std::fprintf(
+      stderr, "plugin lacks random_foreach_test: %s\n", ::dlerror());
+    return EXIT_FAILURE;
+  }
+  return supervise(opt, test);
+}
@@ -0,0 +1,78 @@
+/*
+ * Checks that make_permutation still works in constant evaluation, and
+ * gives the same order as crypto_for_each does at runtime. Nothing else
+ * instantiates it, so a change making GenericFeistel, Dynamic32 or
+ * Dynamic64 non-constexpr would otherwise go unnoticed.
+ *
+ * By Paul Dreik 2019,2020
+ * https://www.pauldreik.se/
+ * License: Boost 1.0
+ * SPDX-License-Identifier: BSL-1.0
+ */
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+
+#include "ConstexprPermutation.h"
+#include "Fnv1aCiphers.h"
+
+namespace {
+
+constexpr std::uint64_t Seed = 1234;
+
+/// true if table holds each of [0,N) exactly once
+template<typename Table>
+constexpr bool
+is_permutation(const Table& table)
+{
+  std::array<bool, std::tuple_size<Table>::value> seen{};
+  for (auto v : table) {
+    if (v >= seen.size() || seen[v]) {
+      return false;
+    }
+    seen[v] = true;
+  }
+  return true;
+}
+
+constexpr auto small = make_permutation<Dynamic32, 4096>(Seed);
+static_assert(is_permutation(small), "not a permutation");
+
+constexpr auto large = make_permutation<Dynamic64, 65536>(Seed);
+static_assert(is_permutation(large), "not a permutation");
+
+/// true if crypto_for_each visits the values in the order of table
+template<typename Crypto, typename Table>
+bool
+same_as_runtime(const Table& table)
+{
+  std::size_t i = 0;
+  bool same = true;
+  crypto_for_each<Crypto>(
+    std::uint64_t{ table.size() }, SplitMix64(Seed), [&](std::uint64_t v) {
+      same = same && i < table.size() && table[i] == v;
+      ++i;
+    });
+  return same && i == table.size();
+}
+}
+
+int
+main()
+{
+  int failures = 0;
+  if (!same_as_runtime<Dynamic32>(small)) {
+    std::puts("FAIL Dynamic32 4096 differs from crypto_for_each");
+    ++failures;
+  }
+  if (!same_as_runtime<Dynamic64>(large)) {
+    std::puts("FAIL Dynamic64 65536 differs from crypto_for_each");
+    ++failures;
+  }
+  if (failures == 0) {
+    std::puts("all ok");
+  }
+  return failures == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,108 @@
+/*
+ * Checks that the cycle walking shuffles move the records: a uniformly
+ * random permutation has on average one fixed point, and the displacement
+ * (p(i)-i) mod M is uniform on [0,M). The two round fnv1a ciphers failed
+ * this, leaving about a quarter of the records in place.
+ *
+ * By Paul Dreik 2019,2020
+ * https://www.pauldreik.se/
+ * License: Boost 1.0
+ * SPDX-License-Identifier: BSL-1.0
+ */
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <numeric>
+#include <random>
+#include <vector>
+
+#include "KeyedPermutation.h"
+#include "PermuteCopy.h"
+
+namespace {
+
+int failures = 0;
+
+void
+check(bool ok, const char* what, std::uint64_t M, std::uint64_t seed)
+{
+  if (!ok) {
+    std::printf("FAIL %s M=%llu seed=%llu\n",
+                what,
+                static_cast<unsigned long long>(M),
+                static_cast<unsigned long long>(seed));
+    ++failures;
+  }
+}
+
+/**
+ * checks that dst is a permutation of [0,M) with few fixed points and
+ * displacements spread evenly over 64 bins
+ */
+void
+check_shuffled(const std::vector<std::uint32_t>& dst,
+               std::uint64_t seed,
+               const char* what)
+{
+  const std::uint64_t M = dst.size();
+  std::vector<bool> seen(M);
+  std::uint64_t fixed = 0;
+  constexpr int Bins = 64;
+  std::vector<double> bins(Bins);
+  bool permutation = true;
+  for (std::uint64_t i = 0; i < M; ++i) {
+    const std::uint64_t v = dst[i];
+    if (v >= M || seen[v]) {
+      permutation = false;
+      break;
+    }
+    seen[v] = true;
+    fixed += v == i;
+    const std::uint64_t displacement = (v + M - i) % M;
+    bins[displacement * Bins / M] += 1;
+  }
+  check(permutation, what, M, seed);
+  // poisson(1), more than 8 happens with probability 1e-6
+  check(fixed <= 8, what, M, seed);
+  double chi2 = 0;
+  for (int b = 0; b < Bins; ++b) {
+    const double lo = std::ceil(static_cast<double>(b) * M / Bins);
+    const double hi = std::ceil(static_cast<double>(b + 1) * M / Bins);
+    const double expected = hi - lo;
+    chi2 += (bins[b] - expected) * (bins[b] - expected) / expected;
+  }
+  // 63 degrees of freedom, five standard deviations above the mean
+  check(chi2 < 63 + 5 * std::sqrt(2.0 * 63), what, M, seed);
+}
+}
+
+int
+main()
+{
+  const std::uint64_t sizes[] = { 1000, 65536, 100003, 1 << 20, 3000017 };
+  for (std::uint64_t M : sizes) {
+    for (std::uint64_t seed : { 1ULL, 2ULL, 12345ULL }) {
+      std::vector<std::uint32_t> src(M);
+      std::iota(src.begin(), src.end(), 0U);
+      std::vector<std::uint32_t> dst(M);
+      permute_copy(src.data(), dst.data(), M, seed, 2);
+      check_shuffled(dst, seed, "permute_copy");
+
+      ShufflePermutation perm(M);
+      std::mt19937_64 rng(seed);
+      perm.seed(rng);
+      bool inverse = true;
+      for (std::uint64_t i = 0; i < M; ++i) {
+        dst[i] = static_cast<std::uint32_t>(perm.value_at(i));
+        inverse = inverse && perm.inverse(dst[i]) == i;
+      }
+      check_shuffled(dst, seed, "ShufflePermutation");
+      check(inverse, "ShufflePermutation inverse", M, seed);
+    }
+  }
+  if (failures == 0) {
+    std::puts("all ok");
+  }
+  return failures == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
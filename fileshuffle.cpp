@@ -0,0 +1,260 @@
+/*
+ * Shuffles a file of fixed size records into a new file, in a random order
+ * given by a keyed permutation. Made for files much larger than memory.
+ *
+ * Writing each record directly to its destination would make the output
+ * random access, which on disk is limited by the number of operations per
+ * second rather than the bandwidth. Instead it is done in two passes over
+ * the data, each of which is sequential or nearly so:
+ *
+ * 1. The output is divided into regions small enough to fit in memory.
+ *    The input is read sequentially, and each record is appended to a
+ *    buffer for the region it is destined to. Full buffers are written at
+ *    the end of the part of the output file belonging to that region.
+ * 2. Each region is read back, ordered in memory and written back.
+ *
+ * In pass 2, the order the records of a region arrived in is recovered by
+ * decrypting the destination positions of the region and sorting them, so
+ * no index needs to be stored along with the records.
+ *
+ * By Paul Dreik 2019,2020
+ * https://www.pauldreik.se/
+ * License: Boost 1.0
+ * SPDX-License-Identifier: BSL-1.0
+ */
+#include <algorithm>
+#include <cerrno>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "KeyedPermutation.h"
+
+namespace {
+
+[[noreturn]] void
+fail(const char* what, const std::string& path)
+{
+  std::fprintf(
+    stderr, "%s %s: %s\n", what, path.c_str(), std::strerror(errno));
+  std::exit(EXIT_FAILURE);
+}
+
+void
+read_fully(int fd, char* buf, std::uint64_t size, std::uint64_t offset)
+{
+  while (size > 0) {
+    const ssize_t n = ::pread(fd, buf, size, static_cast<off_t>(offset));
+    if (n <= 0) {
+      if (n < 0 && errno == EINTR) {
+        continue;
+      }
+      fail("failed reading", "input");
+    }
+    buf += n;
+    size -= static_cast<std::uint64_t>(n);
+    offset += static_cast<std::uint64_t>(n);
+  }
+}
+
+void
+write_fully(int fd, const char* buf, std::uint64_t size, std::uint64_t offset)
+{
+  while (size > 0) {
+    const ssize_t n = ::pwrite(fd, buf, size, static_cast<off_t>(offset));
+    if (n < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      fail("failed writing", "output");
+    }
+    buf += n;
+    size -= static_cast<std::uint64_t>(n);
+    offset += static_cast<std::uint64_t>(n);
+  }
+}
+
+struct Options
+{
+  std::string input;
+  std::string output;
+  std::uint64_t recordsize = 0;
+  std::uint64_t seed = 0;
+  std::uint64_t memory = std::uint64_t{ 1 } << 30;
+  // input is read in chunks of this size in pass 1
+  std::uint64_t readchunk = std::uint64_t{ 8 } << 20;
+};
+
+void
+shuffle(const Options& opt, int in, int out, std::uint64_t M)
+{
+  const std::uint64_t rs = opt.recordsize;
+  if (M == 0) {
+    return;
+  }
+
+  ShufflePermutation perm(M);
+  std::mt19937_64 rng(opt.seed);
+  perm.seed(rng);
+
+  // half of the memory goes to pass 2, which holds a region twice plus
+  // a pair of positions per record.
+  const std::uint64_t R = std::min(
+    M, std::max<std::uint64_t>(1, opt.memory / 2 / (2 * rs + 16)));
+  const std::uint64_t nregions = (M + R - 1) / R;
+  // the other half is for the region buffers in pass 1
+  const std::uint64_t buffered = std::max<std::uint64_t>(
+    1, std::min(R, opt.memory / 2 / nregions / rs));
+  std::fprintf(stderr,
+               "%llu records in %llu regions of %llu records, buffering "
+               "%llu records per region\n",
+               static_cast<unsigned long long>(M),
+               static_cast<unsigned long long>(nregions),
+               static_cast<unsigned long long>(R),
+               static_cast<unsigned long long>(buffered));
+
+  // pass 1 - distribute the records to their regions
+  {
+    std::unique_ptr<char[]> buffers(new char[nregions * buffered * rs]);
+    std::vector<std::uint64_t> fill(nregions, 0);
+    // number of records written to each region so far
+    std::vector<std::uint64_t> written(nregions, 0);
+    auto flush = [&](std::uint64_t r) {
+      write_fully(out,
+                  &buffers[r * buffered * rs],
+                  fill[r] * rs,
+                  (r * R + written[r]) * rs);
+      written[r] += fill[r];
+      fill[r] = 0;
+    };
+
+    const std::uint64_t chunkrecords =
+      std::max<std::uint64_t>(1, opt.readchunk / rs);
+    std::unique_ptr<char[]> chunk(new char[chunkrecords * rs]);
+    for (std::uint64_t first = 0; first < M; first += chunkrecords) {
+      const std::uint64_t n = std::min(chunkrecords, M - first);
+      read_fully(in, chunk.get(), n * rs, first * rs);
+      for (std::uint64_t j = 0; j < n; ++j) {
+        const std::uint64_t dest = perm(first + j);
+        const std::uint64_t r = dest / R;
+        std::memcpy(&buffers[(r * buffered + fill[r]) * rs], &chunk[j * rs], rs);
+        if (++fill[r] == buffered) {
+          flush(r);
+        }
+      }
+    }
+    for (std::uint64_t r = 0; r < nregions; ++r) {
+      flush(r);
+    }
+  }
+
+  // pass 2 - order each region in memory
+  {
+    std::unique_ptr<char[]> arrived(new char[R * rs]);
+    std::unique_ptr<char[]> ordered(new char[R * rs]);
+    // (source position, offset within the region)
+    std::vector<std::pair<std::uint64_t, std::uint64_t>> sources(R);
+    for (std::uint64_t r = 0; r < nregions; ++r) {
+      const std::uint64_t begin = r * R;
+      const std::uint64_t n = std::min(R, M - begin);
+      read_fully(out, arrived.get(), n * rs, begin * rs);
+      for (std::uint64_t j = 0; j < n; ++j) {
+        sources[j] = { perm.inverse(begin + j), j };
+      }
+      // records arrived in order of their source position
+      std::sort(sources.begin(), sources.begin() + n);
+      for (std::uint64_t k = 0; k < n; ++k) {
+        std::memcpy(&ordered[sources[k].second * rs], &arrived[k * rs], rs);
+      }
+      write_fully(out, ordered.get(), n * rs, begin * rs);
+    }
+  }
+}
+
+void
+usage()
+{
+  std::puts("usage: fileshuffle --record-size BYTES [--seed S] "
+            "[--memory BYTES] input output");
+  std::exit(EXIT_FAILURE);
+}
+}
+
+int
+main(int argc, char* argv[])
+{
+  Options opt;
+  std::vector<std::string> paths;
+  // malformed numbers throw from std::sto*
+  try {
+    for (int i = 1; i < argc; ++i) {
+      const std::string arg{ argv[i] };
+      auto value = [&]() {
+        if (i + 1 >= argc) {
+          usage();
+        }
+        return std::stoull(argv[++i]);
+      };
+      if (arg == "--record-size") {
+        opt.recordsize = value();
+      } else if (arg == "--seed") {
+        opt.seed = value();
+      } else if (arg == "--memory") {
+        opt.memory = value();
+      } else if (arg.size() > 1 && arg[0] == '-') {
+        usage();
+      } else {
+        paths.push_back(arg);
+      }
+    }
+  } catch (const std::logic_error&) {
+    usage();
+  }
+  if (paths.size() != 2 || opt.recordsize == 0) {
+    usage();
+  }
+  opt.input = paths[0];
+  opt.output = paths[1];
+
+  const int in = ::open(opt.input.c_str(), O_RDONLY);
+  if (in < 0) {
+    fail("could not open", opt.input);
+  }
+  struct stat st;
+  if (::fstat(in, &st) != 0) {
+    fail("could not stat", opt.input);
+  }
+  const auto size = static_cast<std::uint64_t>(st.st_size);
+  if (size % opt.recordsize != 0) {
+    std::fprintf(stderr, "the file size is not a multiple of the record size\n");
+    return EXIT_FAILURE;
+  }
+  const std::uint64_t M = size / opt.recordsize;
+  ::posix_fadvise(in, 0, 0, POSIX_FADV_SEQUENTIAL);
+
+  const int out = ::open(opt.output.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+  if (out < 0) {
+    fail("could not open", opt.output);
+  }
+  if (::ftruncate(out, static_cast<off_t>(size)) != 0) {
+    fail("could not resize", opt.output);
+  }
+
+  shuffle(opt, in, out, M);
+
+  if (::close(out) != 0) {
+    fail("could not close", opt.output);
+  }
+  ::close(in);
+}
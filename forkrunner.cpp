@@ -0,0 +1,284 @@
+/*
+ * Exhaustive testing of a function over [0,M) in random order, isolated
+ * from crashes in the function under test.
+ *
+ * The test function is loaded from a shared object, which must export
+ *
+ *   extern "C" int random_foreach_test(std::uint64_t value);
+ *
+ * returning nonzero to report a failure. It may also crash, abort or hang.
+ *
+ * The range is visited with crypto_for_each_range, cut into batches of
+ * cipher counters. The plugin is loaded once, and each batch is run in a
+ * forked child so a crash only loses the child. Before each call, the
+ * child stores the counter in memory shared with the parent. When a child
+ * dies, the parent reports the counter and value it died on and forks a
+ * new child which resumes at the next counter. Forking once per batch
+ * instead of once per value keeps the throughput near in process speed.
+ *
+ * By Paul Dreik 2019,2020
+ * https://www.pauldreik.se/
+ * License: Boost 1.0
+ * SPDX-License-Identifier: BSL-1.0
+ */
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cinttypes>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <dlfcn.h>
+#include <signal.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "CryptoForEach.h"
+#include "Fnv1aCiphers.h"
+
+namespace {
+
+using TestFunction = int (*)(std::uint64_t);
+
+struct Options
+{
+  std::string plugin;
+  std::uint64_t M = 0;
+  std::uint64_t seed = 0;
+  std::uint64_t batch = 1U << 20;
+  // per batch, in seconds. 0 means no limit.
+  unsigned timeout = 0;
+};
+
+/**
+ * lives in memory shared between the parent and the children
+ */
+struct SharedProgress
+{
+  // the counter currently being tested by the child, end once it is done
+  std::atomic<std::uint64_t> counter;
+  // set before the first test of a batch, so counter means something
+  std::atomic<bool> started;
+  // number of values the child has tested
+  std::atomic<std::uint64_t> tested;
+  // number of values for which the test function returned nonzero
+  std::atomic<std::uint64_t> failures;
+};
+
+// batches rerun when the child dies before testing anything
+constexpr unsigned MaxRetries = 3;
+
+void
+usage()
+{
+  std::puts("usage: forkrunner [--seed S] [--batch COUNTERS] "
+            "[--timeout SECONDS] plugin.so M");
+  std::exit(EXIT_FAILURE);
+}
+
+/**
+ * runs the counters [begin,end) in a child process. returns the wait status.
+ */
+template<typename Crypto>
+int
+run_batch(Crypto& cipher,
+          const Options& opt,
+          TestFunction test,
+          SharedProgress& progress,
+          std::uint64_t begin,
+          std::uint64_t end)
+{
+  std::fflush(stdout);
+  const pid_t pid = ::fork();
+  if (pid < 0) {
+    std::perror("fork");
+    std::exit(EXIT_FAILURE);
+  }
+  if (pid == 0) {
+    if (opt.timeout > 0) {
+      ::alarm(opt.timeout);
+    }
+    auto cb = [&](std::uint64_t counter, std::uint64_t value) {
+      progress.counter.store(counter, std::memory_order_relaxed);
+      progress.started.store(true, std::memory_order_relaxed);
+      if (test(value) != 0) {
+        progress.failures.fetch_add(1, std::memory_order_relaxed);
+        std::printf(
+          "failure counter=%" PRIu64 " value=%" PRIu64 "\n", counter, value);
+        std::fflush(stdout);
+      }
+      progress.tested.fetch_add(1, std::memory_order_relaxed);
+    };
+    crypto_for_each_range(cipher, opt.M, begin, end, cb);
+    progress.counter.store(end);
+    std::_Exit(EXIT_SUCCESS);
+  }
+  int status = 0;
+  while (::waitpid(pid, &status, 0) < 0) {
+    if (errno != EINTR) {
+      std::perror("waitpid");
+      std::exit(EXIT_FAILURE);
+    }
+  }
+  return status;
+}
+
+template<typename Crypto>
+int
+run(const Options& opt, TestFunction test)
+{
+  const int bits = even_bits_needed(opt.M);
+  Crypto cipher(bits);
+  std::mt19937_64 rng(opt.seed);
+  cipher.seed(rng);
+  const std::uint64_t counters = std::uint64_t{ 1 } << bits;
+
+  void* mem = ::mmap(nullptr,
+                     sizeof(SharedProgress),
+                     PROT_READ | PROT_WRITE,
+                     MAP_SHARED | MAP_ANONYMOUS,
+                     -1,
+                     0);
+  if (mem == MAP_FAILED) {
+    std::perror("mmap");
+    return EXIT_FAILURE;
+  }
+  auto& progress = *new (mem) SharedProgress{};
+
+  std::uint64_t crashes = 0;
+  // children in a row that died before testing anything
+  unsigned retries = 0;
+  const auto start = std::chrono::steady_clock::now();
+  std::uint64_t begin = 0;
+  while (begin < counters) {
+    const std::uint64_t end =
+      counters - begin > opt.batch ? begin + opt.batch : counters;
+    progress.counter.store(begin);
+    progress.started.store(false);
+    const int status = run_batch(cipher, opt, test, progress, begin, end);
+    const std::uint64_t counter = progress.counter.load();
+    // a plugin calling exit(0) must not pass for a completed batch
+    if (WIFEXITED(status) && WEXITSTATUS(status) == EXIT_SUCCESS &&
+        counter == end) {
+      begin = end;
+      retries = 0;
+      continue;
+    }
+    if (!progress.started.load()) {
+      // no value to blame, run the batch again
+      if (++retries > MaxRetries) {
+        std::printf("the child died %u times before testing anything "
+                    "at counter=%" PRIu64 "\n",
+                    retries,
+                    begin);
+        return EXIT_FAILURE;
+      }
+      continue;
+    }
+    retries = 0;
+    ++crashes;
+    if (WIFSIGNALED(status)) {
+      std::printf("crash counter=%" PRIu64 " value=%" PRIu64
+                  " signal=%d%s\n",
+                  counter,
+                  std::uint64_t{ cipher.encrypt(counter) },
+                  WTERMSIG(status),
+                  WTERMSIG(status) == SIGALRM ? " (timeout)" : "");
+    } else {
+      std::printf("crash counter=%" PRIu64 " value=%" PRIu64 " exit=%d\n",
+                  counter,
+                  std::uint64_t{ cipher.encrypt(counter) },
+                  WEXITSTATUS(status));
+    }
+    // the crashing value counts as tested
+    progress.tested.fetch_add(1);
+    begin = counter + 1;
+  }
+  const std::chrono::duration<double> elapsed =
+    std::chrono::steady_clock::now() - start;
+
+  const std::uint64_t tested = progress.tested.load();
+  const std::uint64_t failures = progress.failures.load();
+  ::munmap(mem, sizeof(SharedProgress));
+  std::printf("tested %" PRIu64 " of %" PRIu64 " values in %.3f s "
+              "(%.3g values/s), %" PRIu64 " failures, %" PRIu64 " crashes\n",
+              tested,
+              opt.M,
+              elapsed.count(),
+              tested / elapsed.count(),
+              failures,
+              crashes);
+  return failures + crashes == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+}
+
+int
+main(int argc, char* argv[])
+{
+  Options opt;
+  std::vector<std::string> positional;
+  // malformed numbers throw from std::sto*
+  try {
+    for (int i = 1; i < argc; ++i) {
+      const std::string arg{ argv[i] };
+      auto value = [&]() {
+        if (i + 1 >= argc) {
+          usage();
+        }
+        return std::stoull(argv[++i]);
+      };
+      if (arg == "--seed") {
+        opt.seed = value();
+      } else if (arg == "--batch") {
+        opt.batch = value();
+      } else if (arg == "--timeout") {
+        opt.timeout = static_cast<unsigned>(value());
+      } else if (arg.size() > 1 && arg[0] == '-') {
+        usage();
+      } else {
+        positional.push_back(arg);
+      }
+    }
+    if (positional.size() != 2 || opt.batch == 0) {
+      usage();
+    }
+    opt.plugin = positional[0];
+    opt.M = std::stoull(positional[1]);
+  } catch (const std::logic_error&) {
+    usage();
+  }
+  // the counter space must fit in 64 bits
+  if (opt.M == 0 || opt.M > (std::uint64_t{ 1 } << 62)) {
+    std::puts("M must be in [1,2^62]");
+    return EXIT_FAILURE;
+  }
+
+  // dlopen needs a path, or it searches the library path
+  if (opt.plugin.find('/') == std::string::npos) {
+    opt.plugin = "./" + opt.plugin;
+  }
+  void* handle = ::dlopen(opt.plugin.c_str(), RTLD_NOW);
+  if (!handle) {
+    std::fprintf(stderr, "could not load plugin: %s\n", ::dlerror());
+    return EXIT_FAILURE;
+  }
+  auto test =
+    reinterpret_cast<TestFunction>(::dlsym(handle, "random_foreach_test"));
+  if (!test) {
+    std::fprintf(
+      stderr, "plugin lacks random_foreach_test: %s\n", ::dlerror());
+    return EXIT_FAILURE;
+  }
+
+  if (even_bits_needed(opt.M) <= 32) {
+    return run<Dynamic32>(opt, test);
+  }
+  return run<Dynamic64>(opt, test);
+}
@@ -0,0 +1,26 @@
+/*
+ * Example test function for forkrunner. It fails on some values and
+ * crashes on others, to show how forkrunner reports them:
+ *
+ *   ./forkrunner ./libforkrunner_example.so 1000000
+ *
+ * By Paul Dreik 2019,2020
+ * https://www.pauldreik.se/
+ * License: Boost 1.0
+ * SPDX-License-Identifier: BSL-1.0
+ */
+#include <cstdint>
+#include <cstdlib>
+
+extern "C" int
+random_foreach_test(std::uint64_t value)
+{
+  if (value == 4711) {
+    std::abort();
+  }
+  if (value % 100000 == 42) {
+    volatile int* null = nullptr;
+    return *null;
+  }
+  return value == 12345 ? 1 : 0;
+}
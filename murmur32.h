@@ -5,9 +5,11 @@
  * License: Boost 1.0
  * SPDX-License-Identifier: BSL-1.0
  */
+#include <array>
+#include <cassert>
 #include <cstdint>
 
-#include "ManyU32.h"
+#include "ManyU.h"
 
 class Murmur32 {
 public:
@@ -28,7 +30,7 @@ public:
     }
 
     std::uint32_t encrypt(std::uint32_t x) const {
-    assert( (x & ~mask)==0 && "high bits are set");
+    assert( (x & ~m_mask)==0 && "high bits are set");
         x ^= m_keys[0];
         x ^= (x>>m_shift);
         //x &= m_mask;
@@ -55,39 +57,64 @@ private:
 
 
 
-class SimdMurmur32 {
+namespace SimdMurmurInternals {
+// the multipliers for each lane width. 32 bit is the murmur3 32 bit
+// finalizer, 64 bit the 64 bit one (see MurmurCryptFixed64), and 16 bit
+// the truncated 32 bit ones. they are odd, so the multiplications are
+// invertible.
+template<typename Lane>
+constexpr Lane prime1 =
+  static_cast<Lane>(sizeof(Lane) == 8 ? 0xff51afd7ed558ccdULL : 0xcc9e2d51U);
+template<typename Lane>
+constexpr Lane prime2 =
+  static_cast<Lane>(sizeof(Lane) == 8 ? 0xc4ceb9fe1a85ec53ULL : 0x1b873593U);
+}
+
+/**
+ * @brief The BasicSimdMurmur class
+ * Murmur32 on the lanes of a ManyU<Lane>, so nbits may be up to the lane
+ * width. Narrower lanes give more values per encryption.
+ */
+template<typename Lane>
+class BasicSimdMurmur {
 public:
-    explicit SimdMurmur32(int nbits) : m_mask{0U} {
+    using Vec = ManyU<Lane>;
+    explicit BasicSimdMurmur(int nbits) : m_mask{Lane{0}} {
+        assert(nbits <= static_cast<int>(8 * sizeof(Lane)));
         m_nbits=nbits;
         m_shift=nbits-nbits/2;
-        std::uint32_t mask=1;
-        while(__builtin_popcount(mask)<nbits) {
+        Lane mask=1;
+        while(__builtin_popcountll(mask)<nbits) {
             mask<<=1;
             mask |=1;
         }
-        m_mask=ManyU32{mask};
+        m_mask=Vec{mask};
     }
     template<typename URBG>
     void seed(URBG&& rng) {
-        auto mask=m_mask.get<0>();
+        auto mask=m_mask.template get<0>();
         for(auto& e: m_keys) {
-            e=rng() & mask;
+            Lane key=rng();
+            if constexpr (sizeof(Lane) == 8) {
+                key=(key<<32) ^ rng();
+            }
+            e=key & mask;
         }
-                m_mask=ManyU32{mask};
     }
 
-    ManyU32 encrypt(ManyU32 x) const {
-        x ^= ManyU32{m_keys[0]};
+    Vec encrypt(Vec x) const {
+        using namespace SimdMurmurInternals;
+        x ^= Vec{m_keys[0]};
         x ^= (x>>m_shift);
         //x &= m_mask;
 
-        x *= ManyU32{0xcc9e2d51};
+        x *= Vec{prime1<Lane>};
         x &= m_mask;
 
         x ^= (x>>m_shift);
         //x &= m_mask;
 
-        x *= ManyU32{0x1b873593};
+        x *= Vec{prime2<Lane>};
         x &= m_mask;
 
         x ^= (x>>m_shift);
@@ -97,6 +124,10 @@ public:
 private:
     int m_nbits;
     int m_shift;
-    ManyU32 m_mask;
-    std::array<std::uint32_t,3> m_keys;
+    Vec m_mask;
+    std::array<Lane,3> m_keys;
 };
+
+using SimdMurmur16 = BasicSimdMurmur<std::uint16_t>;
+using SimdMurmur32 = BasicSimdMurmur<std::uint32_t>;
+using SimdMurmur64 = BasicSimdMurmur<std::uint64_t>;
@@ -0,0 +1,366 @@
+/*
+ * Writes the integers [0,N) in random order to stdout, for use in shell
+ * pipelines:
+ *
+ *   permgen --count 1e9 --seed 1234 | some_tool
+ *
+ * The output is either decimal text with one value per line, or binary
+ * 32 or 64 bit words in little or big endian. The order is the one
+ * crypto_for_each<Dynamic32> (or Dynamic64 above 2^32) gives with the same
+ * seed through std::mt19937_64, but it is computed with the simd twin of
+ * the cipher.
+ *
+ * With --shard i/n, only the i:th of n parts of the cipher counters is
+ * run. The n shards together give every value exactly once, so a range
+ * can be split over machines.
+ *
+ * The text formatting converts eight digits at a time with sse2, see
+ * http://0x80.pl/articles/sse-itoa.html and Milo Yip's itoa-benchmark.
+ * Output is collected in a large buffer and written with write(2).
+ *
+ * By Paul Dreik 2019,2020
+ * https://www.pauldreik.se/
+ * License: Boost 1.0
+ * SPDX-License-Identifier: BSL-1.0
+ */
+#include <cerrno>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <random>
+#include <stdexcept>
+#include <string>
+
+#include <immintrin.h>
+#include <unistd.h>
+
+#include "CryptoForEach.h"
+#include "simdfeistel.h"
+
+namespace {
+
+enum class Format
+{
+  Text,
+  LittleEndian,
+  BigEndian
+};
+
+struct Options
+{
+  std::uint64_t count = 0;
+  std::uint64_t seed = 0;
+  std::uint64_t shard = 0;
+  std::uint64_t shards = 1;
+  // bits per binary value, 0 picks 32 or 64 from the count
+  int width = 0;
+  Format format = Format::Text;
+};
+
+/**
+ * converts a value below 10^8 into eight decimal digits (not ascii), in
+ * the eight 16 bit lanes
+ */
+__m128i
+convert8digits(std::uint32_t value)
+{
+  // abcd, efgh = abcdefgh divmod 10000, by multiplying with the inverse
+  const __m128i div10000 = _mm_set1_epi32(static_cast<int>(0xd1b71759));
+  const __m128i abcdefgh = _mm_cvtsi32_si128(static_cast<int>(value));
+  const __m128i abcd =
+    _mm_srli_epi64(_mm_mul_epu32(abcdefgh, div10000), 45);
+  const __m128i efgh = _mm_sub_epi32(
+    abcdefgh, _mm_mul_epu32(abcd, _mm_set1_epi32(10000)));
+
+  // [abcd, efgh] times four, broadcast to four lanes each
+  const __m128i v1 = _mm_slli_epi64(_mm_unpacklo_epi16(abcd, efgh), 2);
+  const __m128i v2a = _mm_unpacklo_epi16(v1, v1);
+  const __m128i v2 = _mm_unpacklo_epi32(v2a, v2a);
+
+  // divide by 10^3, 10^2, 10^1 and 10^0 giving a, ab, abc, abcd (and the
+  // same for efgh), with multiplications and shifts
+  const __m128i divpowers =
+    _mm_setr_epi16(8389, 5243, 13108, -32768, 8389, 5243, 13108, -32768);
+  // 2^7, 2^11, 2^13 and 2^15, as the shifts left after the division
+  const __m128i shiftpowers =
+    _mm_setr_epi16(128, 2048, 8192, -32768, 128, 2048, 8192, -32768);
+  const __m128i v4 =
+    _mm_mulhi_epu16(_mm_mulhi_epu16(v2, divpowers), shiftpowers);
+
+  // subtract ten times the previous lane, a ab abc abcd -> a b c d
+  const __m128i v5 = _mm_mullo_epi16(v4, _mm_set1_epi16(10));
+  return _mm_sub_epi16(v4, _mm_slli_epi64(v5, 16));
+}
+
+/**
+ * shuffle masks moving byte i to i-lead, and clearing the rest
+ */
+struct ShiftTable
+{
+  ShiftTable()
+  {
+    for (int lead = 0; lead < 16; ++lead) {
+      for (int i = 0; i < 16; ++i) {
+        masks[lead][i] = static_cast<char>(i + lead < 16 ? i + lead : -1);
+      }
+    }
+  }
+  alignas(16) char masks[16][16];
+};
+
+/**
+ * writes value in decimal followed by a newline, returns the end. Up to
+ * 24 bytes after out may be written to.
+ */
+char*
+format_line(std::uint64_t value, char* out)
+{
+  static const ShiftTable table;
+  if (value >= 10000000000000000ULL) {
+    // up to four leading digits, the remaining 16 are all printed
+    const auto top = static_cast<unsigned>(value / 10000000000000000ULL);
+    value %= 10000000000000000ULL;
+    out += std::sprintf(out, "%u", top);
+    const __m128i digits = _mm_add_epi8(
+      _mm_packus_epi16(
+        convert8digits(static_cast<std::uint32_t>(value / 100000000)),
+        convert8digits(static_cast<std::uint32_t>(value % 100000000))),
+      _mm_set1_epi8('0'));
+    _mm_storeu_si128((__m128i*)out, digits);
+    out[16] = '\n';
+    return out + 17;
+  }
+  const __m128i digits = _mm_add_epi8(
+    _mm_packus_epi16(
+      convert8digits(static_cast<std::uint32_t>(value / 100000000)),
+      convert8digits(static_cast<std::uint32_t>(value % 100000000))),
+    _mm_set1_epi8('0'));
+  // skip the leading zeros, but keep the last digit
+  const unsigned zeros = static_cast<unsigned>(
+    _mm_movemask_epi8(_mm_cmpeq_epi8(digits, _mm_set1_epi8('0'))));
+  const int lead = __builtin_ctz(~zeros | 0x8000U);
+  const __m128i shifted = _mm_shuffle_epi8(
+    digits, _mm_load_si128((const __m128i*)table.masks[lead]));
+  _mm_storeu_si128((__m128i*)out, shifted);
+  out[16 - lead] = '\n';
+  return out + 17 - lead;
+}
+
+/**
+ * collects output and writes it to stdout in large blocks
+ */
+class Output
+{
+public:
+  // room for a register of values, each the longest line plus what
+  // format_line may write past it
+  static constexpr std::size_t Slack = 16 * 32;
+  static constexpr std::size_t Size = std::size_t{ 4 } << 20;
+
+  Output()
+    : m_buf(new char[Size + Slack])
+    , m_pos(m_buf.get())
+  {}
+  ~Output() { flush(); }
+
+  /// where to write, there is room for at least Slack bytes
+  char* pos() { return m_pos; }
+  void advance(char* end)
+  {
+    m_pos = end;
+    if (m_pos >= m_buf.get() + Size) {
+      flush();
+    }
+  }
+
+  void flush()
+  {
+    const char* p = m_buf.get();
+    while (p < m_pos) {
+      const ssize_t n = ::write(STDOUT_FILENO, p, m_pos - p);
+      if (n < 0) {
+        if (errno == EINTR) {
+          continue;
+        }
+        // most likely the reader went away, like head(1) does
+        std::exit(EXIT_FAILURE);
+      }
+      p += n;
+    }
+    m_pos = m_buf.get();
+  }
+
+private:
+  std::unique_ptr<char[]> m_buf;
+  char* m_pos;
+};
+
+template<typename Word>
+char*
+put_binary(Word value, Format format, char* out)
+{
+  if (format == Format::BigEndian) {
+    if constexpr (sizeof(Word) == 4) {
+      value = __builtin_bswap32(value);
+    } else {
+      value = __builtin_bswap64(value);
+    }
+  }
+  std::memcpy(out, &value, sizeof(value));
+  return out + sizeof(value);
+}
+
+/**
+ * runs the counters of the shard through SimdCrypto, and calls
+ * emit(value, out) for the values below count
+ */
+template<typename SimdCrypto, typename Emit>
+void
+generate(const Options& opt, int bits, Emit emit)
+{
+  using Vec = typename SimdCrypto::Vec;
+  using Lane = typename Vec::Int;
+  constexpr int L = Vec::size();
+
+  SimdCrypto cipher(bits);
+  std::mt19937_64 rng(opt.seed);
+  cipher.seed(rng);
+
+  // split the counters [0,2^bits) in equal parts
+  const unsigned __int128 domain = static_cast<unsigned __int128>(1) << bits;
+  const auto begin =
+    static_cast<std::uint64_t>(domain * opt.shard / opt.shards);
+  const auto end =
+    static_cast<std::uint64_t>(domain * (opt.shard + 1) / opt.shards);
+
+  Output out;
+  Vec II = Vec::iota();
+  II += Vec{ static_cast<Lane>(begin) };
+  const Vec lanes(L);
+  for (std::uint64_t counter = begin; counter < end;
+       counter += L, II += lanes) {
+    const auto values = cipher.encrypt(II).toArray();
+    const int n = end - counter < L ? static_cast<int>(end - counter) : L;
+    char* p = out.pos();
+    for (int j = 0; j < n; ++j) {
+      if (values[j] < opt.count) {
+        p = emit(values[j], p);
+      }
+    }
+    out.advance(p);
+  }
+}
+
+template<typename SimdCrypto>
+void
+generate(const Options& opt, int bits)
+{
+  switch (opt.format) {
+    case Format::Text:
+      generate<SimdCrypto>(opt, bits, format_line);
+      return;
+    case Format::LittleEndian:
+    case Format::BigEndian:
+      if (opt.width == 32) {
+        generate<SimdCrypto>(opt, bits, [&](std::uint64_t value, char* p) {
+          return put_binary(static_cast<std::uint32_t>(value), opt.format, p);
+        });
+      } else {
+        generate<SimdCrypto>(opt, bits, [&](std::uint64_t value, char* p) {
+          return put_binary(value, opt.format, p);
+        });
+      }
+      return;
+  }
+}
+
+void
+usage()
+{
+  std::puts("usage: permgen --count N [--seed S] [--shard I/N] "
+            "[--format text|le|be] [--width 32|64]");
+  std::puts("writes [0,N) in random order to stdout. N may be written as "
+            "1e9 and be at most 2^62.");
+  std::exit(EXIT_FAILURE);
+}
+}
+
+int
+main(int argc, char* argv[])
+{
+  Options opt;
+  // malformed numbers throw from std::sto*
+  try {
+    for (int i = 1; i < argc; ++i) {
+      const std::string arg{ argv[i] };
+      auto value = [&]() {
+        if (i + 1 >= argc) {
+          usage();
+        }
+        return std::string(argv[++i]);
+      };
+      if (arg == "--count") {
+        // accept 1e9 as well as 1000000000, exactly
+        const std::string v = value();
+        if (v.find_first_of("eE.") != std::string::npos) {
+          const long double c = std::stold(v);
+          // out of range would be undefined in the conversion
+          if (!(c >= 0 && c <= static_cast<long double>(1ULL << 62))) {
+            usage();
+          }
+          opt.count = static_cast<std::uint64_t>(c);
+        } else {
+          opt.count = std::stoull(v);
+        }
+      } else if (arg == "--seed") {
+        opt.seed = std::stoull(value());
+      } else if (arg == "--shard") {
+        const std::string v = value();
+        const auto slash = v.find('/');
+        if (slash == std::string::npos) {
+          usage();
+        }
+        opt.shard = std::stoull(v.substr(0, slash));
+        opt.shards = std::stoull(v.substr(slash + 1));
+      } else if (arg == "--width") {
+        opt.width = std::stoi(value());
+      } else if (arg == "--format") {
+        const std::string v = value();
+        if (v == "text") {
+          opt.format = Format::Text;
+        } else if (v == "le") {
+          opt.format = Format::LittleEndian;
+        } else if (v == "be") {
+          opt.format = Format::BigEndian;
+        } else {
+          usage();
+        }
+      } else {
+        usage();
+      }
+    }
+  } catch (const std::logic_error&) {
+    usage();
+  }
+  if (opt.count == 0 || opt.count > (std::uint64_t{ 1 } << 62) ||
+      opt.shards == 0 || opt.shard >= opt.shards) {
+    usage();
+  }
+  if (opt.width == 0) {
+    opt.width = opt.count <= (std::uint64_t{ 1 } << 32) ? 32 : 64;
+  }
+  if ((opt.width != 32 && opt.width != 64) ||
+      (opt.width == 32 && opt.count > (std::uint64_t{ 1 } << 32))) {
+    std::puts("the width must be 32 or 64, and fit the count");
+    return EXIT_FAILURE;
+  }
+
+  const int bits = even_bits_needed(opt.count);
+  if (bits <= 32) {
+    generate<ParallelFeistel>(opt, bits);
+  } else {
+    generate<ParallelFeistel64>(opt, bits);
+  }
+}
@@ -0,0 +1,469 @@
+/*
+ * Quick statistical checks of a 64 bit cipher used as a counter based
+ * generator, encrypt(0), encrypt(1), ... in that order. It is meant as a
+ * gate to pass before spending hours on BigCrush, when trying out round
+ * functions. It is much less thorough than BigCrush, but weeds out the
+ * obviously broken candidates in seconds:
+ *
+ * - bias: each output bit is set half of the time.
+ * - serial: consecutive outputs are uncorrelated, both as numbers in [0,1)
+ *   and bit by bit (each bit changes half of the time).
+ * - avalanche: flipping any input bit flips each output bit half of the
+ *   time. This is measured on random inputs rather than the counters, and
+ *   gives a 64x64 matrix.
+ * - gap: the gaps between outputs falling in [0,1/8) are geometrically
+ *   distributed, as in the gap test of Knuth, TAOCP vol 2, 3.3.2.
+ *
+ * Each test is reduced to a z score, the test fails if it is above the
+ * threshold given with --z. For the tests with many cells, the worst cell
+ * is reported so the threshold must allow for the number of cells; the
+ * default 6 is unlikely to be reached by chance even for the avalanche
+ * matrix. The counters are split over threads.
+ *
+ * By Paul Dreik 2019,2020
+ * https://www.pauldreik.se/
+ * License: Boost 1.0
+ * SPDX-License-Identifier: BSL-1.0
+ */
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <immintrin.h>
+
+#include "Feistel128.h"
+#include "Fnv1aCiphers.h"
+#include "MurmurCryptFixed64.h"
+#include "PlaygroundFeistel.h"
+
+namespace {
+
+struct Options
+{
+  std::string engine;
+  std::uint64_t count = std::uint64_t{ 1 } << 26;
+  unsigned threads = std::max(1U, std::thread::hardware_concurrency());
+  std::uint64_t seed = 0;
+  double z = 6.0;
+};
+
+/**
+ * @brief The BitCounter64 class
+ * Counts how many times each of the 64 bits was set, over all added words.
+ * Each bit is spread out to a byte of its own, so a word is counted with a
+ * few simd instructions. The byte counters are flushed into the totals
+ * before they can overflow.
+ */
+class BitCounter64
+{
+public:
+  BitCounter64() { m_totals.fill(0); }
+
+  void add(std::uint64_t word)
+  {
+    // byte k of lo is byte k/8 of the word, and hi the same for the upper
+    // half. with one bit per byte selected, bytes k holds bit k.
+    const __m256i spread_lo = _mm256_setr_epi8(
+      0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 1, 1, 1, 1, //
+      2, 2, 2, 2, 2, 2, 2, 2, 3, 3, 3, 3, 3, 3, 3, 3);
+    const __m256i spread_hi = _mm256_setr_epi8(
+      4, 4, 4, 4, 4, 4, 4, 4, 5, 5, 5, 5, 5, 5, 5, 5, //
+      6, 6, 6, 6, 6, 6, 6, 6, 7, 7, 7, 7, 7, 7, 7, 7);
+    const __m256i bit = _mm256_set1_epi64x(0x8040201008040201LL);
+    const __m256i w = _mm256_set1_epi64x(static_cast<long long>(word));
+    const __m256i lo =
+      _mm256_and_si256(_mm256_shuffle_epi8(w, spread_lo), bit);
+    const __m256i hi =
+      _mm256_and_si256(_mm256_shuffle_epi8(w, spread_hi), bit);
+    // a set bit gives -1, subtract it
+    m_lo = _mm256_sub_epi8(m_lo, _mm256_cmpeq_epi8(lo, bit));
+    m_hi = _mm256_sub_epi8(m_hi, _mm256_cmpeq_epi8(hi, bit));
+    if (++m_pending == 255) {
+      flush();
+    }
+  }
+
+  /// the number of times each bit was set
+  const std::array<std::uint64_t, 64>& totals()
+  {
+    flush();
+    return m_totals;
+  }
+
+  BitCounter64& operator+=(BitCounter64& other)
+  {
+    const auto& t = other.totals();
+    flush();
+    for (std::size_t i = 0; i < 64; ++i) {
+      m_totals[i] += t[i];
+    }
+    return *this;
+  }
+
+private:
+  void flush()
+  {
+    alignas(32) std::uint8_t bytes[64];
+    _mm256_store_si256((__m256i*)bytes, m_lo);
+    _mm256_store_si256((__m256i*)(bytes + 32), m_hi);
+    for (std::size_t i = 0; i < 64; ++i) {
+      m_totals[i] += bytes[i];
+    }
+    m_lo = _mm256_setzero_si256();
+    m_hi = _mm256_setzero_si256();
+    m_pending = 0;
+  }
+
+  __m256i m_lo = _mm256_setzero_si256();
+  __m256i m_hi = _mm256_setzero_si256();
+  int m_pending = 0;
+  std::array<std::uint64_t, 64> m_totals;
+};
+
+// the gap test looks at outputs in [0,1/8), gaps of GapBins or longer
+// share the last bin
+constexpr int GapBits = 3;
+constexpr int GapBins = 64;
+
+/// what one thread has collected
+struct Partial
+{
+  BitCounter64 ones;
+  BitCounter64 changes;
+  std::array<BitCounter64, 64> avalanche;
+  std::uint64_t samples = 0;
+  // the serial correlation, on outputs mapped to [-1/2,1/2)
+  std::uint64_t pairs = 0;
+  double sx = 0, sy = 0, sxx = 0, syy = 0, sxy = 0;
+  std::array<std::uint64_t, GapBins + 1> gaps{};
+};
+
+std::uint64_t
+splitmix64(std::uint64_t x)
+{
+  x += 0x9e3779b97f4a7c15;
+  x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9;
+  x = (x ^ (x >> 27)) * 0x94d049bb133111eb;
+  return x ^ (x >> 31);
+}
+
+template<typename Cipher>
+void
+collect(Cipher cipher, std::uint64_t begin, std::uint64_t end, Partial& p)
+{
+  auto enc = [&](std::uint64_t x) {
+    return static_cast<std::uint64_t>(cipher.encrypt(x));
+  };
+  auto centered = [](std::uint64_t y) {
+    return static_cast<double>(y >> 11) * 0x1.0p-53 - 0.5;
+  };
+  std::uint64_t prev = 0;
+  std::uint64_t gap = 0;
+  bool hit_before = false;
+  for (std::uint64_t i = begin; i < end; ++i) {
+    const std::uint64_t y = enc(i);
+    p.ones.add(y);
+    if (i != begin) {
+      p.changes.add(y ^ prev);
+      const double a = centered(prev);
+      const double b = centered(y);
+      p.sx += a;
+      p.sy += b;
+      p.sxx += a * a;
+      p.syy += b * b;
+      p.sxy += a * b;
+      ++p.pairs;
+    }
+    if ((y >> (64 - GapBits)) == 0) {
+      // gaps spanning two threads are not counted
+      if (hit_before) {
+        ++p.gaps[std::min<std::uint64_t>(gap, GapBins)];
+      }
+      hit_before = true;
+      gap = 0;
+    } else {
+      ++gap;
+    }
+    prev = y;
+  }
+
+  // one avalanche sample costs 65 encryptions, take one per 64 counters
+  for (std::uint64_t i = begin / 64; i < end / 64; ++i) {
+    const std::uint64_t x = splitmix64(i);
+    const std::uint64_t y = enc(x);
+    for (int b = 0; b < 64; ++b) {
+      p.avalanche[b].add(y ^ enc(x ^ (std::uint64_t{ 1 } << b)));
+    }
+    ++p.samples;
+  }
+}
+
+/// the largest |z| over the cells, where each is expected to be n/2
+double
+worst_z(const std::array<std::uint64_t, 64>& counts, std::uint64_t n)
+{
+  double worst = 0;
+  for (auto c : counts) {
+    const double z = (static_cast<double>(c) - 0.5 * static_cast<double>(n)) /
+                     std::sqrt(0.25 * static_cast<double>(n));
+    worst = std::max(worst, std::fabs(z));
+  }
+  return worst;
+}
+
+bool
+report(const char* name, double z, const Options& opt, const char* what)
+{
+  const bool pass = std::isfinite(z) && z < opt.z;
+  std::printf(
+    "%-10s %-28s %10.2f  %s\n", name, what, z, pass ? "pass" : "FAIL");
+  return pass;
+}
+
+/// runs all tests on the seeded cipher, returns true if all passed
+template<typename Cipher>
+bool
+check(const Options& opt, const Cipher& cipher)
+{
+  const auto start = std::chrono::steady_clock::now();
+  std::vector<Partial> partials(opt.threads);
+  std::vector<std::thread> threads;
+  for (unsigned t = 0; t < opt.threads; ++t) {
+    const std::uint64_t begin = opt.count / opt.threads * t;
+    const std::uint64_t end =
+      t + 1 == opt.threads ? opt.count : opt.count / opt.threads * (t + 1);
+    threads.emplace_back(
+      collect<Cipher>, cipher, begin, end, std::ref(partials[t]));
+  }
+  for (auto& t : threads) {
+    t.join();
+  }
+  Partial& all = partials.front();
+  for (std::size_t t = 1; t < partials.size(); ++t) {
+    Partial& p = partials[t];
+    all.ones += p.ones;
+    all.changes += p.changes;
+    for (std::size_t b = 0; b < 64; ++b) {
+      all.avalanche[b] += p.avalanche[b];
+    }
+    all.samples += p.samples;
+    all.pairs += p.pairs;
+    all.sx += p.sx;
+    all.sy += p.sy;
+    all.sxx += p.sxx;
+    all.syy += p.syy;
+    all.sxy += p.sxy;
+    for (std::size_t g = 0; g < all.gaps.size(); ++g) {
+      all.gaps[g] += p.gaps[g];
+    }
+  }
+  const double elapsed = std::chrono::duration<double>(
+                           std::chrono::steady_clock::now() - start)
+                           .count();
+  std::printf("%llu outputs and %llu avalanche samples in %.2f s, "
+              "%u threads\n",
+              static_cast<unsigned long long>(opt.count),
+              static_cast<unsigned long long>(all.samples),
+              elapsed,
+              opt.threads);
+  std::printf("%-10s %-28s %10s\n", "test", "statistic", "z");
+
+  bool ok = true;
+  ok &= report(
+    "bias", worst_z(all.ones.totals(), opt.count), opt, "worst of 64 bits");
+  ok &= report("serial",
+               worst_z(all.changes.totals(), all.pairs),
+               opt,
+               "worst of 64 bit changes");
+  {
+    const double n = static_cast<double>(all.pairs);
+    const double cov = all.sxy - all.sx * all.sy / n;
+    const double r = cov / std::sqrt((all.sxx - all.sx * all.sx / n) *
+                                     (all.syy - all.sy * all.sy / n));
+    ok &= report("serial", std::fabs(r) * std::sqrt(n), opt, "correlation");
+  }
+  {
+    double worst = 0;
+    for (auto& a : all.avalanche) {
+      worst = std::max(worst, worst_z(a.totals(), all.samples));
+    }
+    ok &= report("avalanche", worst, opt, "worst of 64x64 bits");
+  }
+  {
+    // chi square against the geometric distribution, turned into a z
+    // score with the Wilson-Hilferty approximation
+    std::uint64_t ngaps = 0;
+    for (auto g : all.gaps) {
+      ngaps += g;
+    }
+    const double p = 1.0 / (1 << GapBits);
+    double chi2 = 0;
+    double tail = 1.0;
+    for (int g = 0; g <= GapBins; ++g) {
+      const double prob = g < GapBins ? p * std::pow(1 - p, g) : tail;
+      tail -= prob;
+      const double expected = prob * static_cast<double>(ngaps);
+      const double diff = static_cast<double>(all.gaps[g]) - expected;
+      chi2 += diff * diff / expected;
+    }
+    const double df = GapBins;
+    const double v = 2.0 / (9.0 * df);
+    const double z = (std::cbrt(chi2 / df) - (1 - v)) / std::sqrt(v);
+    ok &= report("gap", z, opt, "chi square, one sided");
+  }
+  std::puts(ok ? "all tests passed" : "some tests FAILED");
+  return ok;
+}
+
+// the names of PlaygroundFeistel64::RoundFuncs, in order
+const char* const round_function_names[] = {
+  "NONE",     "CRC32",    "FN1VA", "ROTATE",   "POPCOUNT",
+  "PDEP1",    "PDEP2",    "PEXT1", "PEXT2",    "DIVIDE",
+  "SUBTRACT", "MULTIPLY", "ADD",   "XOR",      "AES"
+};
+
+constexpr int MaxPlaygroundRounds = 12;
+
+template<int R>
+bool
+check_playground(const Options& opt, const std::vector<int>& funcs)
+{
+  if constexpr (R < MaxPlaygroundRounds) {
+    if (funcs.size() > R) {
+      return check_playground<R + 1>(opt, funcs);
+    }
+  }
+  using Cipher = PlaygroundFeistel64<R>;
+  Cipher cipher(64);
+  std::mt19937_64 rng(opt.seed);
+  cipher.seed(rng);
+  for (int round = 0; round < R; ++round) {
+    using RoundFuncs = typename Cipher::RoundFuncs;
+    cipher.select(round, static_cast<RoundFuncs>(funcs[round]));
+  }
+  return check(opt, cipher);
+}
+
+void
+usage()
+{
+  std::puts("usage: quickcheck [--count N] [--threads T] [--seed S] [--z Z] "
+            "engine");
+  std::puts("engines: dynamic64 murmur64 aes128 mulxor128");
+  std::puts("         playground:F1,F2,... with one round function per round,");
+  std::printf("         at most %d of:", MaxPlaygroundRounds);
+  for (auto name : round_function_names) {
+    std::printf(" %s", name);
+  }
+  std::puts("");
+  std::exit(EXIT_FAILURE);
+}
+
+/// parses a comma separated list of round function names
+std::vector<int>
+parse_round_functions(const std::string& list)
+{
+  std::vector<int> ret;
+  std::size_t pos = 0;
+  for (;;) {
+    const std::size_t comma = list.find(',', pos);
+    const std::string name = list.substr(pos, comma - pos);
+    const auto* const first = std::begin(round_function_names);
+    const auto* const last = std::end(round_function_names);
+    const auto* const it = std::find(first, last, name);
+    if (it == last) {
+      std::printf("unknown round function \"%s\"\n", name.c_str());
+      usage();
+    }
+    ret.push_back(static_cast<int>(it - first));
+    if (comma == std::string::npos) {
+      break;
+    }
+    pos = comma + 1;
+  }
+  if (ret.size() > MaxPlaygroundRounds) {
+    usage();
+  }
+  return ret;
+}
+
+template<typename Cipher>
+bool
+check_seeded(const Options& opt, Cipher cipher)
+{
+  std::mt19937_64 rng(opt.seed);
+  cipher.seed(rng);
+  return check(opt, cipher);
+}
+}
+
+int
+main(int argc, char* argv[])
+{
+  Options opt;
+  // malformed numbers throw from std::sto*
+  try {
+    for (int i = 1; i < argc; ++i) {
+      const std::string arg{ argv[i] };
+      auto value = [&]() {
+        if (i + 1 >= argc) {
+          usage();
+        }
+        return std::string(argv[++i]);
+      };
+      if (arg == "--count") {
+        // accept 1e8 as well as 100000000
+        const double c = std::stod(value());
+        // out of range would be undefined in the conversion
+        if (!(c >= 0 && c < 0x1p64)) {
+          usage();
+        }
+        opt.count = static_cast<std::uint64_t>(c);
+      } else if (arg == "--threads") {
+        opt.threads = static_cast<unsigned>(std::stoul(value()));
+      } else if (arg == "--seed") {
+        opt.seed = std::stoull(value());
+      } else if (arg == "--z") {
+        opt.z = std::stod(value());
+      } else if (arg.size() > 1 && arg[0] == '-') {
+        usage();
+      } else if (opt.engine.empty()) {
+        opt.engine = arg;
+      } else {
+        usage();
+      }
+    }
+  } catch (const std::logic_error&) {
+    usage();
+  }
+  if (opt.engine.empty() || opt.threads == 0 || opt.count < 64 * opt.threads) {
+    usage();
+  }
+
+  bool ok;
+  const std::string playground = "playground:";
+  if (opt.engine == "dynamic64") {
+    ok = check_seeded(opt, Dynamic64(64));
+  } else if (opt.engine == "murmur64") {
+    ok = check_seeded(opt, MurmurCryptFixed64{});
+  } else if (opt.engine == "aes128") {
+    ok = check_seeded(opt, Aes128Feistel<4>(64));
+  } else if (opt.engine == "mulxor128") {
+    ok = check_seeded(opt, MulXorFeistel128<4>(64));
+  } else if (opt.engine.compare(0, playground.size(), playground) == 0) {
+    ok = check_playground<1>(
+      opt, parse_round_functions(opt.engine.substr(playground.size())));
+  } else {
+    usage();
+  }
+  return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
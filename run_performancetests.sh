@@ -16,7 +16,10 @@ exe=$(pwd)/shootout
 cpuname=$(grep "model name" /proc/cpuinfo  |head -n1 |cut -f2 -d: |sed -e 's/^[ \t]*//' -e 's/[ \t]*$//')
 compiler=$($exe --compiler)
 results=res.txt
+# what to do with each value, see $exe --workloads
+workloads=${WORKLOADS:-none}
 #cat /dev/null >$results
+for workload in $workloads ; do
 for prog in $($exe --list) ; do
     skipthisprogram=false
     for size in 25 26 27 28 29 30 31 ; do
@@ -27,9 +30,16 @@ for prog in $($exe --list) ; do
 	#echo -e -n "$cpuname\t$compiler\t$prog\t$size\t" >>$results
 	true /usr/bin/time -f "$cpuname\t$compiler\t$prog\t$size\t%e" \
 		      --output  $results --append \
-		      timeout 10s $exe $prog $((2**$size))
+		      timeout 10s $exe $prog $((2**$size)) $workload
 
-	perf stat -x ';' -o tmp $exe $prog $((2**$size))
+	# the histogram contenders spin on the other cores, count only
+	# the driver thread. for the multithreaded engines, that leaves
+	# out their worker threads.
+	perfopts=
+	if [ $workload = histogram ] ; then
+	    perfopts=--no-inherit
+	fi
+	perf stat $perfopts -x ';' -o tmp $exe $prog $((2**$size)) $workload
 	es=$?
 	if [ $es -ne 0 ] ; then
 	    skipthisprogram=true
@@ -41,11 +51,12 @@ for prog in $($exe --list) ; do
 	instructions=$(grep ";instructions:u;" <tmp |cut -f1 -d';')
 	branches=$(grep ";branches:u;" <tmp |cut -f1 -d';'|head -n1)
 	branchmisses=$(grep ";branch-misses:u;" <tmp |cut -f1 -d';')
-	echo -e "$cpuname\t$compiler\t$prog\t$size\t$elapsed\t$cycles\t$instructions\t$branches\t$branchmisses" >>$results
+	echo -e "$cpuname\t$compiler\t$prog\t$workload\t$size\t$elapsed\t$cycles\t$instructions\t$branches\t$branchmisses" >>$results
 	if [ $(echo "$elapsed > 20" |bc) -eq 1 ] ; then
 	    skipthisprogram=true
 	    continue
 	fi
     done
 done
+done
 
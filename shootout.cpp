@@ -10,25 +10,42 @@
  */
 #include <cassert>
 #include <functional>
+#include <iterator>
+#include <map>
 #include <memory>
+#include <numeric>
 #include <random>
 #include <string>
+#include <unordered_set>
 #include <vector>
 
 #include "AesFunc.h"
+#include "BestForEach.h"
+#include "Feistel128.h"
+#include "Combinations.h"
+#include "CounterRng.h"
+#include "CryptoForEach.h"
+#include "ExcludingForEach.h"
 #include "Fnv1aCiphers.h"
 #include "GenericFeistel.h"
+#include "GrowableRange.h"
+#include "KeyedPermutation.h"
 #include "LazyFisherYates.h"
+#include "MergeShuffle.h"
+#include "MixedRadix.h"
+#include "MultiKeyFeistel.h"
+#include "PermuteCopy.h"
+#include "PipelinedForEach.h"
 #include "PlaygroundFeistel.h"
+#include "Sample.h"
 #include "ShaFeistel.h"
+#include "TabulatedFeistel.h"
+#include "VisitedQuery.h"
+#include "Workloads.h"
 #include "XoroFeistel.h"
 #include "simdfeistel.h"
 #include "murmur32.h"
 
-// empty test function in another translation unit
-void
-donothing(unsigned int);
-
 template<typename Integer, typename Callback>
 void
 std_shuffle(Integer N, Callback&& cb)
@@ -58,6 +75,132 @@ std_shuffle_vector(Integer N, Callback&& cb)
   }
 }
 
+/**
+ * like std_shuffle, but using permute_copy instead of std::shuffle
+ */
+template<typename Integer, typename Callback>
+void
+permute_copy_shuffle(Integer N, unsigned nthreads, Callback&& cb)
+{
+  std::unique_ptr<Integer[]> src(new Integer[N]);
+  std::unique_ptr<Integer[]> dst(new Integer[N]);
+  for (Integer i = 0; i < N; ++i) {
+    src[i] = i;
+  }
+  permute_copy(src.get(), dst.get(), N, std::random_device{}(), nthreads);
+  for (Integer i = 0; i < N; ++i) {
+    cb(dst[i]);
+  }
+}
+
+/**
+ * like std_shuffle, but using the parallel merge_shuffle
+ */
+template<typename Integer, typename Callback>
+void
+merge_shuffle_range(Integer N, unsigned nthreads, Callback&& cb)
+{
+  std::unique_ptr<Integer[]> v(new Integer[N]);
+  for (Integer i = 0; i < N; ++i) {
+    v[i] = i;
+  }
+  merge_shuffle(v.get(), v.get() + N, std::random_device{}(), nthreads);
+  for (Integer i = 0; i < N; ++i) {
+    cb(v[i]);
+  }
+}
+
+/**
+ * iterator over the integers, so std::sample can be used on a range
+ * without storing it
+ */
+struct CountingIterator
+{
+  using iterator_category = std::forward_iterator_tag;
+  using value_type = std::uint64_t;
+  using difference_type = std::int64_t;
+  using pointer = const std::uint64_t*;
+  using reference = std::uint64_t;
+  std::uint64_t value;
+  std::uint64_t operator*() const { return value; }
+  CountingIterator& operator++()
+  {
+    ++value;
+    return *this;
+  }
+  CountingIterator operator++(int) { return CountingIterator{ value++ }; }
+  bool operator==(const CountingIterator& other) const
+  {
+    return value == other.value;
+  }
+  bool operator!=(const CountingIterator& other) const
+  {
+    return value != other.value;
+  }
+};
+
+/**
+ * samples k distinct values out of [0,M) and invokes cb on each
+ */
+template<typename Callback>
+void
+std_sample(std::uint64_t k, std::uint64_t M, Callback&& cb)
+{
+  std::vector<std::uint64_t> v;
+  v.reserve(k);
+  std::sample(CountingIterator{ 0 },
+              CountingIterator{ M },
+              std::back_inserter(v),
+              k,
+              std::mt19937_64{ std::random_device{}() });
+  for (auto e : v) {
+    cb(e);
+  }
+}
+
+template<typename Callback>
+void
+hashset_sample(std::uint64_t k, std::uint64_t M, Callback&& cb)
+{
+  std::unordered_set<std::uint64_t> seen;
+  seen.reserve(k);
+  std::vector<std::uint64_t> v;
+  v.reserve(k);
+  std::mt19937_64 rng{ std::random_device{}() };
+  std::uniform_int_distribution<std::uint64_t> dist(0, M - 1);
+  while (v.size() < k) {
+    const auto candidate = dist(rng);
+    if (seen.insert(candidate).second) {
+      v.push_back(candidate);
+    }
+  }
+  for (auto e : v) {
+    cb(e);
+  }
+}
+
+template<typename Callback>
+void
+feistel_sample(std::uint64_t k, std::uint64_t M, Callback&& cb)
+{
+  std::vector<std::uint64_t> v(k);
+  sample(k, M, std::random_device{}(), v.begin());
+  for (auto e : v) {
+    cb(e);
+  }
+}
+
+template<typename Callback>
+void
+simd_sample(std::uint64_t k, std::uint64_t M, Callback&& cb)
+{
+  std::vector<std::uint32_t> v(k);
+  sample_fill(v.data(), k, M, std::random_device{}());
+  for (auto e : v) {
+    cb(e);
+  }
+}
+
 template<typename Integer, typename Callback>
 void
 ordinary_for(Integer N, Callback&& cb)
@@ -167,104 +310,50 @@ random_for_each(Integer N, URBG&& rng, Callback&& cb)
 }
 
 /**
- * block cipher based visitation of each integer exactly
- * once
+ * invokes cb on N raw outputs from the generator
  */
-template<typename Crypto, typename Integer, typename URBG, typename Callback>
+template<typename Integer, typename URBG, typename Callback>
 void
-crypto_for_each(Integer M, URBG&& rng, Callback&& cb)
+rng_for_each(Integer N, URBG&& rng, Callback&& cb)
 {
-  // how many bits do we need?
-  int bitsneeded = static_cast<int>(std::ceil(std::log2(M)));
-  // round up to even
-  bitsneeded /= 2;
-  bitsneeded *= 2;
-
-  if (bitsneeded <= 32) {
-    Crypto cipher(bitsneeded);
-    // auto s=sizeof(cipher);
-    cipher.seed(rng);
-    Integer count = 0;
-    for (Integer i = 0; count < M; ++i) {
-      auto encrypted = cipher.encrypt(i);
-      if (encrypted < M) {
-        cb(encrypted);
-        ++count;
-      }
-    }
-    return;
+  for (Integer i = 0; i < N; ++i) {
+    cb(rng());
   }
-  std::puts("implement switching to 64 bit");
-  std::abort();
 }
 
 /**
- * like feistel_for_each, but simd parallelized
+ * like rng_for_each, but fills a buffer at a time using rng.generate()
  */
 template<typename Integer, typename URBG, typename Callback>
 void
-simdfeistel_for_each(Integer M, URBG&& rng, Callback&& cb)
+rng_generate_for_each(Integer N, URBG&& rng, Callback&& cb)
 {
-  // how many bits do we need?
-  int bitsneeded = static_cast<int>(std::ceil(std::log2(M)));
-  // round up to even
-  bitsneeded /= 2;
-  bitsneeded *= 2;
-
-  if (bitsneeded <= 32) {
-    ParallelFeistel cipher(bitsneeded);
-    cipher.seed(rng);
-    ManyU32 II(0, 1, 2, 3, 4, 5, 6, 7);
-    const ManyU32 ones(1);
-    for (Integer count = 0; count < M; II += ones) {
-      auto ea = cipher.encrypt(II).toArray();
-      for (auto encrypted : ea) {
-        if (encrypted < M) {
-          cb(encrypted);
-          ++count;
-          if (count >= M) {
-            return;
-          }
-        }
-      }
+  std::uint64_t buf[1024];
+  for (Integer i = 0; i < N;) {
+    const Integer n = std::min<Integer>(N - i, std::size(buf));
+    rng.generate(buf, buf + n);
+    for (Integer j = 0; j < n; ++j) {
+      cb(buf[j]);
     }
-    return;
+    i += n;
   }
-  std::puts("implement switching to 64 bit");
-  std::abort();
 }
 
-template<typename Integer, typename URBG, typename Callback>
+/**
+ * visits [0,N) as passes over a domain of at most 2^16 values, so the simd
+ * lane widths can be compared on a small domain
+ */
+template<typename SimdCrypto, typename Integer, typename Callback>
 void
-simdmurmur_for_each(Integer M, URBG&& rng, Callback&& cb)
+small_domain_passes(Integer N, Callback& cb)
 {
-  // how many bits do we need?
-  int bitsneeded = static_cast<int>(std::ceil(std::log2(M)));
-
-  if (bitsneeded <= 32) {
-    SimdMurmur32 cipher(bitsneeded);
-    cipher.seed(rng);
-    ManyU32 II(0, 1, 2, 3, 4, 5, 6, 7);
-    const ManyU32 ones(1);
-    for (Integer count = 0; count < M; II += ones) {
-      auto ea = cipher.encrypt(II).toArray();
-      for (auto encrypted : ea) {
-        if (encrypted < M) {
-          cb(encrypted);
-          ++count;
-          if (count >= M) {
-            return;
-          }
-        }
-      }
-    }
-    return;
+  const Integer M = std::min<Integer>(N, Integer{ 1 } << 16);
+  for (Integer done = 0; done < N; done += M) {
+    simd_crypto_for_each<SimdCrypto>(
+      M, even_bits_needed(M), std::random_device{}, cb);
   }
-  std::puts("implement switching to 64 bit");
-  std::abort();
 }
 
-
 int
 main(int argc, char* argv[])
 {
@@ -274,6 +363,10 @@ main(int argc, char* argv[])
   // arg 2 - size of test
   const unsigned long long Ntmp = argc > 2 ? std::stoull(argv[2]) : (1U << 30);
 
+  // arg 3 - what to do with each value, see Workloads.h
+  const auto kind =
+    argc > 3 ? Workload::from_name(argv[3]) : Workload::Kind::None;
+
   using Integer = std::uint32_t;
   if (Ntmp >= std::numeric_limits<Integer>::max()) {
     std::puts("sorry, too large for the test");
@@ -283,15 +376,8 @@ main(int argc, char* argv[])
 
   std::map<std::string, std::function<void()>> functions;
 
-  auto work = [](auto x) {
-#if 1
-    donothing(x);
-#else
-    auto actual = count_set_bits(x);
-    auto expected = __builtin_popcount(x);
-    assert(actual == expected);
-#endif
-  };
+  Workload workload(kind, N);
+  auto work = [&](auto x) { workload(x); };
 
   functions["xor"] = [&]() { xored_for_each(N, std::random_device{}, work); };
   functions["dowhile"] = [&]() { do_while(N, work); };
@@ -312,12 +398,123 @@ main(int argc, char* argv[])
     random_for_each(N, std::mt19937_64{ std::random_device{}() }, work);
   };
 
+  functions["random_counter_fnv1a"] = [&]() {
+    random_for_each(N, CounterRng<Dynamic64>{ std::random_device{}() }, work);
+  };
+  functions["random_counter_murmur"] = [&]() {
+    random_for_each(
+      N, CounterRng<MurmurCryptFixed64>{ std::random_device{}() }, work);
+  };
+  functions["random_counter_aes"] = [&]() {
+    random_for_each(
+      N, CounterRng<Aes128Feistel<4>>{ std::random_device{}() }, work);
+  };
+
+  // raw generator output, without a distribution on top
+  functions["rng_mt19937_64"] = [&]() {
+    rng_for_each(N, std::mt19937_64{ std::random_device{}() }, work);
+  };
+  functions["rng_counter_fnv1a"] = [&]() {
+    rng_for_each(N, CounterRng<Dynamic64>{ std::random_device{}() }, work);
+  };
+  functions["rng_counter_fnv1a_generate"] = [&]() {
+    rng_generate_for_each(
+      N, CounterRng<Dynamic64>{ std::random_device{}() }, work);
+  };
+  functions["rng_counter_murmur"] = [&]() {
+    rng_for_each(
+      N, CounterRng<MurmurCryptFixed64>{ std::random_device{}() }, work);
+  };
+  functions["rng_counter_murmur_generate"] = [&]() {
+    rng_generate_for_each(
+      N, CounterRng<MurmurCryptFixed64>{ std::random_device{}() }, work);
+  };
+  functions["rng_counter_aes"] = [&]() {
+    rng_for_each(
+      N, CounterRng<Aes128Feistel<4>>{ std::random_device{}() }, work);
+  };
+
   functions["lazy_fisher_yates_19937"] = [&]() {
     lazy_fisher_yates(N, std::mt19937{ std::random_device{}() }, work);
   };
   functions["std_shuffle"] = [&]() { std_shuffle(N, work); };
 
   functions["std_shuffle_vector"] = [&]() { std_shuffle_vector(N, work); };
+  functions["permute_copy"] = [&]() { permute_copy_shuffle(N, 0, work); };
+  functions["permute_copy_1thread"] = [&]() {
+    permute_copy_shuffle(N, 1, work);
+  };
+  functions["merge_shuffle"] = [&]() { merge_shuffle_range(N, 0, work); };
+  functions["merge_shuffle_1thread"] = [&]() {
+    merge_shuffle_range(N, 1, work);
+  };
+
+  // the sampling variants pick N distinct values out of 16N
+  const std::uint64_t sampleRange = std::min<std::uint64_t>(
+    std::uint64_t{ 16 } * N, std::numeric_limits<std::uint32_t>::max());
+  functions["sample_std"] = [&]() { std_sample(N, sampleRange, work); };
+  functions["sample_hashset"] = [&]() { hashset_sample(N, sampleRange, work); };
+  functions["sample_feistel"] = [&]() { feistel_sample(N, sampleRange, work); };
+  functions["sample_simd"] = [&]() { simd_sample(N, sampleRange, work); };
+
+  // the mixed radix variants visit a product space of (about) N tuples,
+  // and decode each index into its components
+  const MixedRadixSpace<4> space({ 7, 5, 13, std::max(1U, N / (7 * 5 * 13)) });
+  auto workTuple = [&](const auto& t) { work(t[0] ^ t[1] ^ t[2] ^ t[3]); };
+  functions["mixed_radix_divmod"] = [&]() {
+    const auto& r = space.radices();
+    crypto_for_each<Dynamic32>(
+      space.size(), std::random_device{}, [&](std::uint64_t i) {
+        MixedRadixSpace<4>::Tuple t;
+        for (std::size_t d = 0; d < 3; ++d) {
+          t[d] = i % r[d];
+          i /= r[d];
+        }
+        t[3] = i;
+        workTuple(t);
+      });
+  };
+  functions["mixed_radix"] = [&]() {
+    mixed_radix_for_each<Dynamic32>(space, std::random_device{}, workTuple);
+  };
+  functions["mixed_radix_simd"] = [&]() {
+    mixed_radix_simd_for_each(
+      space, std::random_device{}, [&](const auto& c, unsigned mask) {
+        const auto x = (c[0] ^ c[1] ^ c[2] ^ c[3]).toArray();
+        for (unsigned lane = 0; lane < 8; ++lane) {
+          if (mask & (1U << lane)) {
+            work(x[lane]);
+          }
+        }
+      });
+  };
+
+  // the pair variants visit all pairs i<j of n elements, where n is
+  // chosen so there are about N pairs
+  const auto pairN = static_cast<std::uint32_t>(std::sqrt(2.0 * N)) + 1;
+  auto workPair = [&](const auto& p) { work(p[0] ^ (p[1] << 16)); };
+  functions["pairs_naive"] = [&]() {
+    crypto_for_each<Dynamic64>(
+      std::uint64_t{ pairN } * pairN, std::random_device{}, [&](std::uint64_t x) {
+        const std::uint64_t i = x % pairN;
+        const std::uint64_t j = x / pairN;
+        if (i < j) {
+          workPair(std::array<std::uint64_t, 2>{ { i, j } });
+        }
+      });
+  };
+  functions["pairs_unrank"] = [&]() {
+    const CombinationSpace<2> pairs(pairN);
+    combinations_for_each<Dynamic64>(pairs, std::random_device{}, workPair);
+  };
+  functions["triples_unrank"] = [&]() {
+    const auto n = static_cast<std::uint64_t>(std::cbrt(6.0 * N)) + 2;
+    const CombinationSpace<3> triples(n);
+    combinations_for_each<Dynamic64>(
+      triples, std::random_device{}, [&](const auto& t) {
+        work(t[0] ^ (t[1] << 10) ^ (t[2] << 20));
+      });
+  };
 
   functions["fn1va_feistel"] = [&]() {
     crypto_for_each<Dynamic32>(N, std::random_device{}, work);
@@ -333,6 +530,40 @@ main(int argc, char* argv[])
     crypto_for_each<ShaFeistel32<2>>(N, std::random_device{}, work);
   };
 
+  functions["aes_feistel128"] = [&]() {
+    crypto_for_each<Aes128Feistel<4>>(uint128{ N }, std::random_device{}, work);
+  };
+  functions["mulxor_feistel128"] = [&]() {
+    crypto_for_each<MulXorFeistel128<4>>(
+      uint128{ N }, std::random_device{}, work);
+  };
+  // the first N positions of a permutation over a range of about 2^127,
+  // like pairs of 64 bit operands
+  functions["aes_feistel128_value_at"] = [&]() {
+    const uint128 M = (uint128{ 1 } << 127) - 1;
+    CycleWalkingPermutation<Aes128Feistel<4>, uint128> perm(M);
+    std::random_device rd;
+    perm.seed(rd);
+    for (Integer i = 0; i < N; ++i) {
+      const uint128 ab = perm.value_at(i);
+      work(static_cast<std::uint64_t>(ab) ^
+           static_cast<std::uint64_t>(ab >> 64));
+    }
+  };
+
+  functions["fn1va_feistel_tabulated"] = [&]() {
+    tabulated_for_each<Dynamic32>(N, std::random_device{}, work);
+  };
+  functions["aes_feistel_tabulated"] = [&]() {
+    tabulated_for_each<Aes32<2>>(N, std::random_device{}, work);
+  };
+  functions["sha1_feistel_tabulated"] = [&]() {
+    tabulated_for_each<ShaFeistel32<2>>(N, std::random_device{}, work);
+  };
+  functions["simd_feistel_tabulated"] = [&]() {
+    tabulated_simd_for_each<Dynamic32>(N, std::random_device{}, work);
+  };
+
   functions["murmur"] = [&]() {
     crypto_for_each<Murmur32>(N, std::random_device{}, work);
   };
@@ -350,12 +581,152 @@ main(int argc, char* argv[])
   functions["simd_feistel"] = [&]() {
     simdfeistel_for_each(N, std::random_device{}, work);
   };
+  functions["bitsliced_feistel"] = [&]() {
+    bitsliced_for_each(N, std::random_device{}, work);
+  };
+  // the fastest engine on this host, benchmarked on first use
+  functions["best"] = [&]() {
+    best_for_each(N, std::random_device{}(), work);
+  };
+  // asks if each of [0,N) was visited by a run that is halfway through
+  functions["visited_query"] = [&]() {
+    VisitedQuery<Dynamic32> query(N, std::random_device{});
+    const ForEachCheckpoint halfway{ (std::uint64_t{ 1 }
+                                      << even_bits_needed(N)) / 2 };
+    for (Integer i = 0; i < N; ++i) {
+      work(query.was_visited(i, halfway));
+    }
+  };
+  functions["visited_query_batch"] = [&]() {
+    VisitedQuery<Dynamic32> query(N, std::random_device{});
+    const ForEachCheckpoint halfway{ (std::uint64_t{ 1 }
+                                      << even_bits_needed(N)) / 2 };
+    Integer values[1024];
+    std::uint8_t visited[1024];
+    for (Integer i = 0; i < N;) {
+      const Integer n = std::min<Integer>(N - i, 1024);
+      std::iota(values, values + n, i);
+      query.was_visited(values, n, halfway, visited);
+      for (Integer j = 0; j < n; ++j) {
+        work(visited[j]);
+      }
+      i += n;
+    }
+  };
+  // interesting values first, then the rest minus the excluded ones
+  functions["excluding_none"] = [&]() {
+    excluding_for_each(
+      N, std::random_device{}, {}, interesting_values(N), work);
+  };
+  functions["excluding_odd"] = [&]() {
+    CompressedBitmap odd;
+    for (Integer i = 1; i < N; i += 2) {
+      odd.add(i);
+    }
+    excluding_for_each(
+      N, std::random_device{}, std::move(odd), interesting_values(N), work);
+  };
+  functions["simd_feistel_lanes16_small"] = [&]() {
+    small_domain_passes<ParallelFeistel16>(N, work);
+  };
+  functions["simd_feistel_lanes32_small"] = [&]() {
+    small_domain_passes<ParallelFeistel>(N, work);
+  };
+  functions["simd_feistel_lanes64_small"] = [&]() {
+    small_domain_passes<ParallelFeistel64>(N, work);
+  };
+  // starts on [0,N/2), grows to [0,N) when half of that is visited
+  functions["growable"] = [&]() {
+    GrowableRange<> range(N / 2, std::random_device{});
+    std::uint64_t value;
+    for (Integer i = 0; i < N / 4 && range.next(value); ++i) {
+      work(value);
+    }
+    range.grow(N);
+    range.for_each(work);
+  };
+  // the 64 bit capable ciphers, on [0,N)
+  functions["fn1va_feistel64"] = [&]() {
+    crypto_for_each<Dynamic64>(N, std::random_device{}, work);
+  };
+  functions["simd_feistel_lanes64"] = [&]() {
+    simd_crypto_for_each<ParallelFeistel64>(
+      N, even_bits_needed(N), std::random_device{}, work);
+  };
+
+  // eight independent random orders of [0,N), one after another or all in
+  // one pass with a key per lane
+  functions["simd_feistel_8keys_serial"] = [&]() {
+    for (int k = 0; k < 8; ++k) {
+      simdfeistel_for_each(N, std::random_device{}, work);
+    }
+  };
+  functions["simd_feistel_8keys_multikey"] = [&]() {
+    multikey_for_each(
+      N, 8, std::random_device{}, [&](int, std::uint32_t x) { work(x); });
+  };
+
+  // the bigarray variants read one element per visited integer from an
+  // array of 8*N bytes, to show the effect of prefetching
+  std::unique_ptr<std::uint64_t[]> bigarray;
+  std::uint64_t bigsum = 0;
+  auto makeBigArray = [&]() {
+    bigarray.reset(new std::uint64_t[N]);
+    std::iota(bigarray.get(), bigarray.get() + N, std::uint64_t{ 0 });
+  };
+  auto readBigArray = [&](auto x) { bigsum += bigarray[x]; };
+  auto prefetchBigArray = [&](auto x) { __builtin_prefetch(&bigarray[x]); };
+  constexpr int lookahead = 32;
+
+  functions["bigarray_fn1va_feistel"] = [&]() {
+    makeBigArray();
+    crypto_for_each<Dynamic32>(N, std::random_device{}, readBigArray);
+    donothing(bigsum);
+  };
+  functions["bigarray_fn1va_feistel_prefetch"] = [&]() {
+    makeBigArray();
+    crypto_for_each<Dynamic32, lookahead>(
+      N, std::random_device{}, readBigArray, prefetchBigArray);
+    donothing(bigsum);
+  };
+  functions["bigarray_simd_feistel"] = [&]() {
+    makeBigArray();
+    simdfeistel_for_each(N, std::random_device{}, readBigArray);
+    donothing(bigsum);
+  };
+  functions["bigarray_simd_feistel_prefetch"] = [&]() {
+    makeBigArray();
+    simdfeistel_for_each<lookahead>(
+      N, std::random_device{}, readBigArray, prefetchBigArray);
+    donothing(bigsum);
+  };
+  functions["bigarray_simdmurmur_prefetch"] = [&]() {
+    makeBigArray();
+    simdmurmur_for_each<lookahead>(
+      N, std::random_device{}, readBigArray, prefetchBigArray);
+    donothing(bigsum);
+  };
+
+  functions["pipelined_fn1va_feistel"] = [&]() {
+    PipelineOptions opt;
+    const unsigned cores = std::thread::hardware_concurrency();
+    opt.consumers = cores > 1 ? cores - 1 : 1;
+    auto stats =
+      pipelined_for_each<Dynamic32>(N, std::random_device{}, work, opt);
+    stats.print(stderr);
+  };
   if (algoname == "--list") {
     for (auto& e : functions) {
       std::puts(e.first.c_str());
     }
     std::exit(EXIT_SUCCESS);
   }
+  if (algoname == "--workloads") {
+    for (int k = 0; k < Workload::Kinds; ++k) {
+      std::puts(Workload::name(static_cast<Workload::Kind>(k)));
+    }
+    std::exit(EXIT_SUCCESS);
+  }
   if (algoname == "--compiler") {
 #define STRINGIFY2(x) #x
 #define STRINGIFY(x) STRINGIFY2(x)
@@ -373,5 +744,10 @@ main(int argc, char* argv[])
     std::puts("could not find that function");
     std::exit(EXIT_FAILURE);
   }
+  workload.start();
   it->second();
+  workload.stop();
+#if RANDOM_FOREACH_STATS
+  last_foreach_stats().print(stderr);
+#endif
 }
@@ -6,9 +6,14 @@
  * SPDX-License-Identifier: BSL-1.0
  */
 #include <immintrin.h>
+#include <array>
+#include <cassert>
+#include <cstdint>
+#include <type_traits>
 
 #include "GenericFeistel.h"
 
+#include "ManyU.h"
 #include "ManyU32.h"
 
 // 16 bit fnv1a hash, assuming the input is
@@ -41,24 +46,91 @@ hashfnv1a_16(ManyU32 value) noexcept
   return hash ^ (hash >> 16);
 }
 
+// 8 bit fnv1a hash in 16 bit lanes, assuming the input is zero in the
+// most significant byte. the low 16 bits of the 32 bit fnv1a are computed
+// and folded in half.
+static ManyU16
+hashfnv1a_8(ManyU16 value) noexcept
+{
+  const ManyU16 prime{ 0x0193 };
+  ManyU16 hash{ 0x9dc5 };
+  hash ^= value;
+  hash *= prime;
+  return hash ^ (hash >> 8);
+}
+
+// 32 bit fnv1a hash in 64 bit lanes, assuming the input is zero in the
+// most significant bits. Same as DynamicInternals::hashfnv1a(uint32_t).
+static ManyU64
+hashfnv1a_32(ManyU64 value) noexcept
+{
+  const __m256i prime = _mm256_set1_epi64x(0x1000193);
+  const __m256i lastbytemask = _mm256_set1_epi64x(0xFF);
+  // the multiplication only looks at the low 32 bits of each lane, which
+  // is all that is needed for a 32 bit hash.
+  __m256i hash = _mm256_set1_epi64x(0x811c9dc5);
+  for (int shift = 0; shift < 32; shift += 8) {
+    const __m256i byte =
+      _mm256_and_si256(_mm256_srli_epi64(value.m_x, shift), lastbytemask);
+    hash = _mm256_xor_si256(hash, byte);
+    hash = _mm256_mul_epu32(hash, prime);
+  }
+  return ManyU64{ _mm256_and_si256(hash, _mm256_set1_epi64x(0xFFFFFFFF)) };
+}
+
+namespace SimdFeistelInternals {
+// the round function hash and key type for each lane width
+inline ManyU16
+hash(ManyU16 x) noexcept
+{
+  return hashfnv1a_8(x);
+}
+inline ManyU32
+hash(ManyU32 x) noexcept
+{
+  return hashfnv1a_16(x);
+}
+inline ManyU64
+hash(ManyU64 x) noexcept
+{
+  return hashfnv1a_32(x);
+}
+template<typename Lane>
+using Key = std::conditional_t<
+  sizeof(Lane) == 2,
+  std::uint8_t,
+  std::conditional_t<sizeof(Lane) == 4, std::uint16_t, std::uint32_t>>;
+}
+
 /**
- * @brief The ParallelFeistel class
+ * @brief The BasicParallelFeistel class
  * A try to encrypt multiple values in parallel, using simd, to gain
- * some speed.
+ * some speed. Lane is the lane type of the ManyU the halves are kept in,
+ * so the block is at most as wide as Lane:
+ * 16 bit lanes gives 16 values per encryption, for domains up to 2^16.
+ * 32 bit lanes gives 8 values per encryption, for domains up to 2^32.
+ * 64 bit lanes gives 4 values per encryption, for domains up to 2^64.
  *
- * cycles for 2**30 values, skylake:
+ * With 32 and 64 bit lanes, each lane gives the same result as
+ * Dynamic32 and Dynamic64 respectively, seeded the same way.
+ *
+ * cycles for 2**30 values, skylake (32 bit lanes):
  * capto16  9152170408 # incorrect fnv (truncated)
  * proper16 9462775491 # correct fnv (folded)
  * aes      9566842315
  */
-class ParallelFeistel : public GenericFeistel<ParallelFeistel, ManyU32, ManyU32>
+template<typename Lane>
+class BasicParallelFeistel
+  : public GenericFeistel<BasicParallelFeistel<Lane>, ManyU<Lane>, ManyU<Lane>>
 {
 public:
   static constexpr int ROUNDS = 2;
-  using Base = GenericFeistel<ParallelFeistel, ManyU32, ManyU32>;
-  explicit ParallelFeistel(int Nbits)
+  using Vec = ManyU<Lane>;
+  using Base = GenericFeistel<BasicParallelFeistel<Lane>, Vec, Vec>;
+  explicit BasicParallelFeistel(int Nbits)
     : Base(Nbits)
   {
+    assert(Nbits <= static_cast<int>(8 * sizeof(Lane)));
     m_key.fill(0);
   }
   template<typename URBG>
@@ -69,11 +141,15 @@ public:
     }
   }
 
-  ManyU32 roundFunction( ManyU32 x, int round) const
+  Vec roundFunction(Vec x, int round) const
   {
-    return hashfnv1a_16(x) ^ ManyU32 { m_key[round] };
+    return SimdFeistelInternals::hash(x) ^ Vec{ m_key[round] };
   }
 
 private:
-  std::array<std::uint16_t, ROUNDS> m_key;
+  std::array<SimdFeistelInternals::Key<Lane>, ROUNDS> m_key;
 };
+
+using ParallelFeistel16 = BasicParallelFeistel<std::uint16_t>;
+using ParallelFeistel = BasicParallelFeistel<std::uint32_t>;
+using ParallelFeistel64 = BasicParallelFeistel<std::uint64_t>;